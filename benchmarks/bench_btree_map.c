@@ -0,0 +1,153 @@
+#include "bench_common.h"
+#include "../cstd_map.h"
+#include "../cstd_btree_map.h"
+
+/*
+ * Insert, lookup and delete throughput of the AVL map_t against the
+ * B-tree btree_map_t, with 64-bit keys inserted in random and in
+ * ascending order. Lookups and deletes visit the keys in random order
+ * in both cases, so the sequential run only changes the shape of the
+ * build.
+ *
+ * Usage: bench_btree_map [count]   (default 1000000)
+ */
+
+static int32_t
+key_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_avl(const char* order, const uint64_t* keys, const uint64_t* probes,
+          const uint64_t* misses, size_t count) {
+    char name[64];
+    map_t map;
+    cstd_map_init(&map, sizeof(uint64_t), sizeof(uint64_t), key_compare);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_map_insert(&map, &keys[i], &keys[i]);
+    }
+    snprintf(name, sizeof(name), "map insert (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_map_find(&map, &probes[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "map find hit (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_map_find(&map, &misses[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "map find miss (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_map_delete(&map, &probes[i]);
+    }
+    snprintf(name, sizeof(name), "map delete (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    if (found != count || map.size != 0) {
+        printf("unexpected result: %zu hits, %zu left\n", found, map.size);
+    }
+    cstd_map_free(&map);
+}
+
+static void
+bench_btree(const char* order, const uint64_t* keys, const uint64_t* probes,
+            const uint64_t* misses, size_t count) {
+    char name[64];
+    btree_map_t map;
+    cstd_btree_map_init(&map, sizeof(uint64_t), sizeof(uint64_t),
+                        key_compare);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_btree_map_insert(&map, &keys[i], &keys[i]);
+    }
+    snprintf(name, sizeof(name), "btree_map insert (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_btree_map_find(&map, &probes[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "btree_map find hit (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_btree_map_find(&map, &misses[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "btree_map find miss (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_btree_map_delete(&map, &probes[i]);
+    }
+    snprintf(name, sizeof(name), "btree_map delete (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    if (found != count || map.size != 0) {
+        printf("unexpected result: %zu hits, %zu left\n", found, map.size);
+    }
+    cstd_btree_map_free(&map);
+}
+
+/*
+ * Fisher-Yates shuffle driven by the benchmark generator.
+ */
+static void
+shuffle(uint64_t* keys, size_t count, uint64_t* state) {
+    for (size_t i = count; i > 1; i--) {
+        size_t j = (size_t)(bench_rand(state) % i);
+        uint64_t tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    uint64_t* keys = (uint64_t*)malloc(count * sizeof(uint64_t));
+    uint64_t* probes = (uint64_t*)malloc(count * sizeof(uint64_t));
+    uint64_t* misses = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!keys || !probes || !misses) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // Even keys are stored and odd keys miss, in both orders
+    uint64_t state = 42;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = (uint64_t)i * 2;
+        misses[i] = (uint64_t)i * 2 + 1;
+    }
+    memcpy(probes, keys, count * sizeof(uint64_t));
+    shuffle(probes, count, &state);
+    shuffle(misses, count, &state);
+
+    printf("entries: %zu\n", count);
+    bench_avl("sequential", keys, probes, misses, count);
+    bench_btree("sequential", keys, probes, misses, count);
+
+    memcpy(keys, probes, count * sizeof(uint64_t));
+    shuffle(probes, count, &state);
+    bench_avl("random", keys, probes, misses, count);
+    bench_btree("random", keys, probes, misses, count);
+
+    free(keys);
+    free(probes);
+    free(misses);
+    return 0;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <time.h>
+
+#include "../cstd_common.h"
+
+/*
+ * Helpers shared by the benchmarks. Each benchmark is a single C file
+ * that builds on its own, for example:
+ *
+ *     cc -O2 -march=native -o bench benchmarks/bench_hash_index.c
+ */
+
+/*
+ * Returns a monotonically increasing time in seconds.
+ */
+cstd_inline double
+bench_now(void) {
+    struct timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/*
+ * SplitMix64 generator, used to produce reproducible keys.
+ */
+cstd_inline uint64_t
+bench_rand(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+/*
+ * Parses the element count from the first command line argument,
+ * falling back to the given default.
+ */
+cstd_inline size_t
+bench_arg_count(int argc, char** argv, size_t fallback) {
+    if (argc > 1) {
+        size_t count = (size_t)strtoull(argv[1], NULL, 10);
+        if (count > 0) {
+            return count;
+        }
+    }
+    return fallback;
+}
+
+/*
+ * Prints one result line as operations per second.
+ */
+cstd_inline void
+bench_report(const char* name, size_t ops, double seconds) {
+    printf("%-40s %12zu ops %10.3f s %12.2f Mops/s\n",
+           name, ops, seconds, (double)ops / seconds / 1e6);
+}
+
+#ifdef BENCH_COUNT_ALLOCATIONS
+/*
+ * Counting allocator, available when BENCH_COUNT_ALLOCATIONS is defined
+ * before including this header. Containers initialized with
+ * &bench_counting_allocator through their _with_allocator functions
+ * allocate from malloc while bench_heap tracks the number of
+ * allocations and the bytes currently requested.
+ */
+typedef struct {
+    size_t allocations;
+    size_t live_bytes;
+    size_t peak_bytes;
+} bench_heap_t;
+
+static bench_heap_t bench_heap;
+
+cstd_inline void
+bench_heap_grow(bench_heap_t* heap, size_t size) {
+    heap->live_bytes += size;
+    if (heap->live_bytes > heap->peak_bytes) {
+        heap->peak_bytes = heap->live_bytes;
+    }
+}
+
+cstd_inline void*
+bench_allocate(void* context, size_t size) {
+    bench_heap_t* heap = (bench_heap_t*)context;
+    void* data = malloc(size);
+    if (data) {
+        heap->allocations++;
+        bench_heap_grow(heap, size);
+    }
+    return data;
+}
+
+cstd_inline void*
+bench_reallocate(void* context, void* data, size_t old_size,
+                 size_t new_size) {
+    bench_heap_t* heap = (bench_heap_t*)context;
+    void* moved = realloc(data, new_size);
+    if (moved) {
+        heap->allocations++;
+        heap->live_bytes -= old_size;
+        bench_heap_grow(heap, new_size);
+    }
+    return moved;
+}
+
+cstd_inline void
+bench_deallocate(void* context, void* data, size_t size) {
+    bench_heap_t* heap = (bench_heap_t*)context;
+    heap->live_bytes -= size;
+    free(data);
+}
+
+static const cstd_allocator_t bench_counting_allocator = {
+    bench_allocate,
+    bench_reallocate,
+    bench_deallocate,
+    &bench_heap
+};
+#endif
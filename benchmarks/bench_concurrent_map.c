@@ -0,0 +1,150 @@
+#include "../cstd_concurrent_unordered_map.h"
+#include "bench_common.h"
+
+/*
+ * Thread scaling of concurrent_unordered_map_t against an unordered_map_t
+ * behind one global mutex. The table is preloaded with count keys drawn
+ * from a key space of 2 * count; every thread then runs its share of a
+ * fixed number of operations for two mixes:
+ *
+ *     read-heavy   95% find,  5% insert
+ *     write-heavy  50% find, 25% insert, 25% erase
+ *
+ * Build with -pthread. Usage: bench_concurrent_map [count]
+ * (default 1000000)
+ */
+
+#define BENCH_TOTAL_OPS 4000000
+#define BENCH_MAX_THREADS 64
+
+static uint32_t
+key_hash(const void* key) {
+    return (uint32_t)*(const uint64_t*)key;
+}
+
+static bool
+key_equals(const void* a, const void* b) {
+    return *(const uint64_t*)a == *(const uint64_t*)b;
+}
+
+typedef struct {
+    concurrent_unordered_map_t* striped;
+    unordered_map_t*            locked;
+    pthread_mutex_t*            mutex;
+    size_t                      key_space;
+    size_t                      ops;
+    uint32_t                    read_percent;
+    uint64_t                    seed;
+} bench_thread_t;
+
+static void*
+bench_worker(void* arg) {
+    bench_thread_t* t = (bench_thread_t*)arg;
+    uint64_t state = t->seed;
+    uint64_t value = 0;
+    for (size_t i = 0; i < t->ops; i++) {
+        uint64_t r = bench_rand(&state);
+        uint64_t key = (r >> 8) % t->key_space;
+        uint32_t op = (uint32_t)(r & 0xff) % 100;
+        if (t->striped) {
+            if (op < t->read_percent) {
+                cstd_concurrent_unordered_map_find(t->striped, &key, &value);
+            } else if (op % 2 == 0 || t->read_percent > 90) {
+                cstd_concurrent_unordered_map_insert(t->striped, &key, &key);
+            } else {
+                cstd_concurrent_unordered_map_erase(t->striped, &key);
+            }
+        } else {
+            pthread_mutex_lock(t->mutex);
+            if (op < t->read_percent) {
+                uint64_t* found =
+                    (uint64_t*)cstd_unordered_map_find(t->locked, &key);
+                if (found) {
+                    value = *found;
+                }
+            } else if (op % 2 == 0 || t->read_percent > 90) {
+                cstd_unordered_map_insert(t->locked, &key, &key);
+            } else {
+                cstd_unordered_map_erase(t->locked, &key);
+            }
+            pthread_mutex_unlock(t->mutex);
+        }
+    }
+    return (void*)(uintptr_t)value;
+}
+
+static void
+bench_run(const char* name, bool striped, size_t count,
+          uint32_t read_percent, size_t thread_count) {
+    concurrent_unordered_map_t cmap;
+    unordered_map_t map;
+    pthread_mutex_t mutex;
+    pthread_t threads[BENCH_MAX_THREADS];
+    bench_thread_t args[BENCH_MAX_THREADS];
+
+    if (striped) {
+        cstd_concurrent_unordered_map_init(&cmap, sizeof(uint64_t),
+                                           sizeof(uint64_t), key_hash,
+                                           key_equals);
+    } else {
+        cstd_unordered_map_init(&map, sizeof(uint64_t), sizeof(uint64_t),
+                                key_hash, key_equals);
+        pthread_mutex_init(&mutex, NULL);
+    }
+    uint64_t state = 7;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t key = bench_rand(&state) % (2 * count);
+        if (striped) {
+            cstd_concurrent_unordered_map_insert(&cmap, &key, &key);
+        } else {
+            cstd_unordered_map_insert(&map, &key, &key);
+        }
+    }
+
+    for (size_t i = 0; i < thread_count; i++) {
+        args[i].striped = striped ? &cmap : NULL;
+        args[i].locked = &map;
+        args[i].mutex = &mutex;
+        args[i].key_space = 2 * count;
+        args[i].ops = BENCH_TOTAL_OPS / thread_count;
+        args[i].read_percent = read_percent;
+        args[i].seed = 1000 + i;
+    }
+    double start = bench_now();
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_create(&threads[i], NULL, bench_worker, &args[i]);
+    }
+    for (size_t i = 0; i < thread_count; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    double elapsed = bench_now() - start;
+
+    char label[64];
+    snprintf(label, sizeof(label), "%s %2zu threads", name, thread_count);
+    bench_report(label, args[0].ops * thread_count, elapsed);
+
+    if (striped) {
+        cstd_concurrent_unordered_map_free(&cmap);
+    } else {
+        cstd_unordered_map_free(&map);
+        pthread_mutex_destroy(&mutex);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    const uint32_t mixes[] = {95, 50};
+    const char* mix_names[] = {"read-heavy", "write-heavy"};
+
+    printf("entries: %zu, operations per run: %d\n", count, BENCH_TOTAL_OPS);
+    for (size_t m = 0; m < 2; m++) {
+        for (size_t threads = 1; threads <= BENCH_MAX_THREADS; threads *= 2) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s striped", mix_names[m]);
+            bench_run(name, true, count, mixes[m], threads);
+            snprintf(name, sizeof(name), "%s mutex", mix_names[m]);
+            bench_run(name, false, count, mixes[m], threads);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,274 @@
+#include "bench_common.h"
+#include "../cstd_unordered_map.h"
+#include "../cstd_unordered_set.h"
+
+/*
+ * Lookup and rehash throughput of unordered_map_t and unordered_set_t.
+ * Keys are random 64-bit integers hashed by truncation, which is the
+ * kind of weak user hash that bucket masking has to cope with. The
+ * number of hash function calls is reported alongside, since rehashing
+ * with cached hashes should not call it at all.
+ *
+ * Built with -DBENCH_HASH_BASELINE, it also runs the chained map as it
+ * was before bucket masking and hash caching: a bucket is picked by
+ * taking the raw hash modulo the bucket count, and nodes store no hash,
+ * so every node visited is compared by key and rehashing calls the hash
+ * function again. This is the baseline the current numbers compare to.
+ *
+ * Usage: bench_hash_index [count]   (default 1000000)
+ */
+
+static size_t hash_calls;
+
+static uint32_t
+map_hash(const void* key) {
+    hash_calls++;
+    return (uint32_t)*(const uint64_t*)key;
+}
+
+static bool
+map_equals(const void* a, const void* b) {
+    return *(const uint64_t*)a == *(const uint64_t*)b;
+}
+
+static size_t
+set_hash(const void* key) {
+    hash_calls++;
+    return (size_t)*(const uint64_t*)key;
+}
+
+static int32_t
+set_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_map(const uint64_t* keys, const uint64_t* misses, size_t count) {
+    unordered_map_t map;
+    cstd_unordered_map_init(&map, sizeof(uint64_t), sizeof(uint64_t),
+                            map_hash, map_equals);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_unordered_map_insert(&map, &keys[i], &keys[i]);
+    }
+    bench_report("unordered_map insert", count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_unordered_map_find(&map, &keys[i]) != NULL;
+    }
+    bench_report("unordered_map find (hit)", count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_unordered_map_find(&map, &misses[i]) != NULL;
+    }
+    bench_report("unordered_map find (miss)", count, bench_now() - start);
+
+    hash_calls = 0;
+    start = bench_now();
+    cstd_unordered_map_resize_and_rehash(&map, map.capacity * 2);
+    bench_report("unordered_map rehash", map.size, bench_now() - start);
+    printf("%-40s %12zu\n", "  hash calls during rehash", hash_calls);
+
+    if (found != count) {
+        printf("unexpected hit count %zu\n", found);
+    }
+    cstd_unordered_map_free(&map);
+}
+
+#ifdef BENCH_HASH_BASELINE
+/*
+ * The chained map before bucket masking and hash caching, reduced to
+ * insert, find and rehash.
+ */
+typedef struct baseline_node {
+    struct baseline_node* next;
+    unsigned char         data[];
+} baseline_node_t;
+
+typedef struct {
+    baseline_node_t** buckets;
+    size_t            size;
+    size_t            capacity;
+    size_t            key_size;
+    size_t            value_size;
+    uint32_t (*hash_function)(const void* key);
+    bool     (*key_equals)(const void* key1, const void* key2);
+} baseline_map_t;
+
+static void
+baseline_map_rehash(baseline_map_t* map, size_t new_capacity) {
+    baseline_node_t** new_buckets =
+        (baseline_node_t**)calloc(new_capacity, sizeof(baseline_node_t*));
+    for (size_t i = 0; i < map->capacity; i++) {
+        baseline_node_t* node = map->buckets[i];
+        while (node) {
+            baseline_node_t* next = node->next;
+            size_t index = map->hash_function(node->data) % new_capacity;
+            node->next = new_buckets[index];
+            new_buckets[index] = node;
+            node = next;
+        }
+    }
+    free(map->buckets);
+    map->buckets = new_buckets;
+    map->capacity = new_capacity;
+}
+
+static void*
+baseline_map_find(baseline_map_t* map, const void* key) {
+    size_t index = map->hash_function(key) % map->capacity;
+    for (baseline_node_t* node = map->buckets[index]; node;
+         node = node->next) {
+        if (map->key_equals(node->data, key)) {
+            return node->data + map->key_size;
+        }
+    }
+    return NULL;
+}
+
+static void
+baseline_map_insert(baseline_map_t* map, const void* key,
+                    const void* value) {
+    if (map->size >= map->capacity * 3 / 4) {
+        baseline_map_rehash(map, map->capacity * 2);
+    }
+    size_t index = map->hash_function(key) % map->capacity;
+    for (baseline_node_t* node = map->buckets[index]; node;
+         node = node->next) {
+        if (map->key_equals(node->data, key)) {
+            memcpy(node->data + map->key_size, value, map->value_size);
+            return;
+        }
+    }
+    baseline_node_t* node = (baseline_node_t*)malloc(
+        sizeof(baseline_node_t) + map->key_size + map->value_size);
+    memcpy(node->data, key, map->key_size);
+    memcpy(node->data + map->key_size, value, map->value_size);
+    node->next = map->buckets[index];
+    map->buckets[index] = node;
+    map->size++;
+}
+
+static void
+baseline_map_free(baseline_map_t* map) {
+    for (size_t i = 0; i < map->capacity; i++) {
+        baseline_node_t* node = map->buckets[i];
+        while (node) {
+            baseline_node_t* next = node->next;
+            free(node);
+            node = next;
+        }
+    }
+    free(map->buckets);
+}
+
+static void
+bench_baseline_map(const uint64_t* keys, const uint64_t* misses,
+                   size_t count) {
+    baseline_map_t map = {
+        (baseline_node_t**)calloc(16, sizeof(baseline_node_t*)), 0, 16,
+        sizeof(uint64_t), sizeof(uint64_t), map_hash, map_equals
+    };
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        baseline_map_insert(&map, &keys[i], &keys[i]);
+    }
+    bench_report("baseline map insert", count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += baseline_map_find(&map, &keys[i]) != NULL;
+    }
+    bench_report("baseline map find (hit)", count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += baseline_map_find(&map, &misses[i]) != NULL;
+    }
+    bench_report("baseline map find (miss)", count, bench_now() - start);
+
+    hash_calls = 0;
+    start = bench_now();
+    baseline_map_rehash(&map, map.capacity * 2);
+    bench_report("baseline map rehash", map.size, bench_now() - start);
+    printf("%-40s %12zu\n", "  hash calls during rehash", hash_calls);
+
+    if (found != count) {
+        printf("unexpected hit count %zu\n", found);
+    }
+    baseline_map_free(&map);
+}
+#endif
+
+static void
+bench_set(const uint64_t* keys, const uint64_t* misses, size_t count) {
+    unordered_set_t set;
+    cstd_unordered_set_init(&set, sizeof(uint64_t), set_hash, set_compare);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_unordered_set_insert(&set, &keys[i]);
+    }
+    bench_report("unordered_set insert", count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_unordered_set_find(&set, &keys[i]);
+    }
+    bench_report("unordered_set find (hit)", count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_unordered_set_find(&set, &misses[i]);
+    }
+    bench_report("unordered_set find (miss)", count, bench_now() - start);
+
+    hash_calls = 0;
+    start = bench_now();
+    cstd_unordered_set_resize(&set, set.bucket_count * 2);
+    bench_report("unordered_set rehash", set.size, bench_now() - start);
+    printf("%-40s %12zu\n", "  hash calls during rehash", hash_calls);
+
+    if (found != count) {
+        printf("unexpected hit count %zu\n", found);
+    }
+    cstd_unordered_set_free(&set);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    uint64_t* keys = (uint64_t*)malloc(count * sizeof(uint64_t));
+    uint64_t* misses = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!keys || !misses) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    // Misses come from an independent stream, so collisions are negligible
+    uint64_t key_state = 42;
+    uint64_t miss_state = 4242;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = bench_rand(&key_state);
+        misses[i] = bench_rand(&miss_state);
+    }
+
+    printf("entries: %zu\n", count);
+#ifdef BENCH_HASH_BASELINE
+    bench_baseline_map(keys, misses, count);
+#endif
+    bench_map(keys, misses, count);
+    bench_set(keys, misses, count);
+
+    free(keys);
+    free(misses);
+    return 0;
+}
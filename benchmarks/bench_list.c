@@ -0,0 +1,84 @@
+#include "bench_common.h"
+#include "../cstd_list.h"
+
+/*
+ * Node-per-element list_t against the unrolled layout, with 32-bit
+ * elements: appending, a full iteration, positional lookups and
+ * positional inserts and erases at random indices, and draining from
+ * the front.
+ *
+ * Usage: bench_list [count]   (default 100000)
+ */
+
+static bool
+sum_element(void* data, void* context) {
+    *(uint64_t*)context += *(const uint32_t*)data;
+    return true;
+}
+
+static void
+bench_layout(const char* layout, list_t* lst, size_t count) {
+    char name[64];
+    uint64_t state = 42;
+    size_t positional = count / 50 + 1;
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = (uint32_t)i;
+        cstd_list_push_back(lst, &value);
+    }
+    snprintf(name, sizeof(name), "list push_back (%s)", layout);
+    bench_report(name, count, bench_now() - start);
+
+    uint64_t sum = 0;
+    start = bench_now();
+    for (int pass = 0; pass < 10; pass++) {
+        cstd_list_for_each(lst, sum_element, &sum);
+    }
+    snprintf(name, sizeof(name), "list iterate (%s)", layout);
+    bench_report(name, 10 * count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < positional; i++) {
+        size_t index = (size_t)(bench_rand(&state) % lst->size);
+        sum += *(const uint32_t*)cstd_list_at(lst, index);
+    }
+    snprintf(name, sizeof(name), "list at (%s)", layout);
+    bench_report(name, positional, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < positional; i++) {
+        uint32_t value = (uint32_t)i;
+        cstd_list_insert(lst, (size_t)(bench_rand(&state) % lst->size),
+                         &value);
+        cstd_list_erase(lst, (size_t)(bench_rand(&state) % lst->size));
+    }
+    snprintf(name, sizeof(name), "list insert+erase (%s)", layout);
+    bench_report(name, 2 * positional, bench_now() - start);
+
+    start = bench_now();
+    while (!cstd_list_empty(lst)) {
+        cstd_list_pop_front(lst);
+    }
+    snprintf(name, sizeof(name), "list pop_front (%s)", layout);
+    bench_report(name, count, bench_now() - start);
+
+    if (sum == 0) {
+        printf("unexpected sum\n");
+    }
+    cstd_list_free(lst);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 100000);
+    list_t lst;
+
+    printf("elements: %zu\n", count);
+    cstd_list_init(&lst, sizeof(uint32_t));
+    bench_layout("nodes", &lst, count);
+    cstd_list_init_unrolled(&lst, sizeof(uint32_t), 0);
+    bench_layout("unrolled 256B", &lst, count);
+    cstd_list_init_unrolled(&lst, sizeof(uint32_t), 1024);
+    bench_layout("unrolled 1KB", &lst, count);
+    return 0;
+}
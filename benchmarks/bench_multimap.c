@@ -0,0 +1,104 @@
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_common.h"
+#include "../cstd_multimap.h"
+
+/*
+ * Memory footprint and ingest speed of an inverted index kept in
+ * multimap_t, in the default mode (one vector per key) and in compact
+ * mode (inline values spilling to a shared arena). Keys are 64-bit ids
+ * and postings 32-bit document numbers. Most keys get one to three
+ * postings, so the median is two, and one key in 1024 gets 256.
+ *
+ * Usage: bench_multimap [keys]   (default 1000000)
+ */
+
+static int32_t
+key_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_mode(const char* mode, bool compact, const uint64_t* keys,
+           size_t postings) {
+    char name[64];
+    multimap_t mmap;
+    size_t allocations = bench_heap.allocations;
+    size_t base_bytes = bench_heap.live_bytes;
+
+    if (compact) {
+        cstd_multimap_init_compact_with_allocator(
+            &mmap, sizeof(uint64_t), sizeof(uint32_t), key_compare,
+            &bench_counting_allocator);
+    } else {
+        cstd_multimap_init_with_allocator(
+            &mmap, sizeof(uint64_t), sizeof(uint32_t), key_compare,
+            &bench_counting_allocator);
+    }
+
+    double start = bench_now();
+    for (size_t i = 0; i < postings; i++) {
+        uint32_t document = (uint32_t)i;
+        cstd_multimap_insert(&mmap, (void*)&keys[i], &document);
+    }
+    snprintf(name, sizeof(name), "multimap insert (%s)", mode);
+    bench_report(name, postings, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < postings; i++) {
+        vector_t* values = cstd_multimap_get(&mmap, (void*)&keys[i]);
+        found += values && values->size > 0;
+    }
+    snprintf(name, sizeof(name), "multimap get (%s)", mode);
+    bench_report(name, postings, bench_now() - start);
+
+    size_t bytes = bench_heap.live_bytes - base_bytes;
+    printf("  %zu keys, %.1f bytes per posting, %.2f allocations per key\n",
+           cstd_multimap_size(&mmap), (double)bytes / (double)postings,
+           (double)(bench_heap.allocations - allocations) /
+               (double)cstd_multimap_size(&mmap));
+
+    if (found != postings) {
+        printf("unexpected hit count %zu\n", found);
+    }
+    cstd_multimap_free(&mmap);
+}
+
+int main(int argc, char** argv) {
+    size_t key_count = bench_arg_count(argc, argv, 1000000);
+    uint64_t state = 42;
+
+    size_t postings = 0;
+    for (size_t i = 0; i < key_count; i++) {
+        postings += (i % 1024 == 0) ? 256 : 1 + (size_t)(i % 3);
+    }
+    uint64_t* keys = (uint64_t*)malloc(postings * sizeof(uint64_t));
+    if (!keys) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    size_t n = 0;
+    for (size_t i = 0; i < key_count; i++) {
+        size_t count = (i % 1024 == 0) ? 256 : 1 + (i % 3);
+        uint64_t id = bench_rand(&state);
+        for (size_t j = 0; j < count; j++) {
+            keys[n++] = id;
+        }
+    }
+    // Postings arrive in random order, as they would from documents
+    for (size_t i = postings; i > 1; i--) {
+        size_t j = (size_t)(bench_rand(&state) % i);
+        uint64_t tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+
+    printf("keys: %zu, postings: %zu\n", key_count, postings);
+    bench_mode("vector", false, keys, postings);
+    bench_mode("compact", true, keys, postings);
+
+    free(keys);
+    return 0;
+}
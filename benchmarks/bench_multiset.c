@@ -0,0 +1,84 @@
+#include "bench_common.h"
+#include "../cstd_multiset.h"
+
+/*
+ * Insert, find and remove throughput of multiset_t for sorted,
+ * reverse-sorted and random insertion streams of 64-bit keys. Every key
+ * appears four times, so duplicates collapse into node counts.
+ *
+ * Usage: bench_multiset [count]   (default 1000000)
+ */
+
+static int
+key_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static void
+bench_stream(const char* order, const uint64_t* keys, size_t count) {
+    char name[64];
+    multiset_t set;
+    cstd_multiset_init(&set, sizeof(uint64_t), key_compare);
+
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_multiset_insert(&set, (void*)&keys[i]);
+    }
+    snprintf(name, sizeof(name), "multiset insert (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    size_t found = 0;
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        found += cstd_multiset_find(&set, (void*)&keys[i]) != NULL;
+    }
+    snprintf(name, sizeof(name), "multiset find (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_multiset_remove(&set, (void*)&keys[i]);
+    }
+    snprintf(name, sizeof(name), "multiset remove (%s)", order);
+    bench_report(name, count, bench_now() - start);
+
+    if (found != count || !cstd_multiset_empty(&set)) {
+        printf("unexpected result: %zu hits, %zu left\n",
+               found, cstd_multiset_size(&set));
+    }
+    cstd_multiset_free(&set);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    uint64_t* keys = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!keys) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+
+    printf("elements: %zu\n", count);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = (uint64_t)(i / 4);
+    }
+    bench_stream("sorted", keys, count);
+
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = (uint64_t)((count - 1 - i) / 4);
+    }
+    bench_stream("reverse", keys, count);
+
+    uint64_t state = 42;
+    for (size_t i = count; i > 1; i--) {
+        size_t j = (size_t)(bench_rand(&state) % i);
+        uint64_t tmp = keys[i - 1];
+        keys[i - 1] = keys[j];
+        keys[j] = tmp;
+    }
+    bench_stream("random", keys, count);
+
+    free(keys);
+    return 0;
+}
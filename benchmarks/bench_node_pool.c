@@ -0,0 +1,121 @@
+#include "bench_common.h"
+#include "../cstd_map.h"
+#include "../cstd_unordered_map.h"
+
+/*
+ * Churn throughput of node containers with nodes from malloc against
+ * nodes from a cstd_node_pool_t. Each round erases every other live key
+ * and inserts as many new ones, so node allocations and frees dominate.
+ *
+ * Usage: bench_node_pool [count]   (default 200000)
+ */
+
+#define ROUNDS 8
+
+static int32_t
+key_compare(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static uint32_t
+key_hash(const void* key) {
+    uint64_t k = *(const uint64_t*)key;
+    return (uint32_t)(k ^ (k >> 32));
+}
+
+static bool
+key_equals(const void* a, const void* b) {
+    return *(const uint64_t*)a == *(const uint64_t*)b;
+}
+
+static void
+bench_map(const char* name, const cstd_allocator_t* allocator,
+          uint64_t* keys, size_t count) {
+    map_t map;
+    cstd_map_init_with_allocator(&map, sizeof(uint64_t), sizeof(uint64_t),
+                                 key_compare, allocator);
+    uint64_t state = 7;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_map_insert(&map, &keys[i], &keys[i]);
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t i = round & 1; i < count; i += 2) {
+            cstd_map_delete(&map, &keys[i]);
+            keys[i] = bench_rand(&state);
+            cstd_map_insert(&map, &keys[i], &keys[i]);
+        }
+    }
+    cstd_map_free(&map);
+    bench_report(name, count + ROUNDS * count, bench_now() - start);
+}
+
+static void
+bench_unordered_map(const char* name, const cstd_allocator_t* allocator,
+                    uint64_t* keys, size_t count) {
+    unordered_map_t map;
+    cstd_unordered_map_init_with_allocator(&map, sizeof(uint64_t),
+                                           sizeof(uint64_t), key_hash,
+                                           key_equals, allocator);
+    uint64_t state = 7;
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        cstd_unordered_map_insert(&map, &keys[i], &keys[i]);
+    }
+    for (int round = 0; round < ROUNDS; round++) {
+        for (size_t i = round & 1; i < count; i += 2) {
+            cstd_unordered_map_erase(&map, &keys[i]);
+            keys[i] = bench_rand(&state);
+            cstd_unordered_map_insert(&map, &keys[i], &keys[i]);
+        }
+    }
+    cstd_unordered_map_free(&map);
+    bench_report(name, count + ROUNDS * count, bench_now() - start);
+}
+
+/*
+ * Fills keys with the same pseudo-random sequence for every run.
+ */
+static void
+fill_keys(uint64_t* keys, size_t count) {
+    uint64_t state = 42;
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = bench_rand(&state);
+    }
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 200000);
+    uint64_t* keys = (uint64_t*)malloc(count * sizeof(uint64_t));
+    if (!keys) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    printf("live keys: %zu, rounds: %d\n", count, ROUNDS);
+
+    cstd_node_pool_t pool;
+    fill_keys(keys, count);
+    bench_map("map churn (malloc)", NULL, keys, count);
+    cstd_node_pool_init(&pool, cstd_map_node_size(sizeof(uint64_t),
+                                                  sizeof(uint64_t)),
+                        0, NULL);
+    fill_keys(keys, count);
+    bench_map("map churn (node pool)", cstd_node_pool_allocator(&pool),
+              keys, count);
+    cstd_node_pool_free(&pool);
+
+    fill_keys(keys, count);
+    bench_unordered_map("unordered_map churn (malloc)", NULL, keys, count);
+    cstd_node_pool_init(&pool, cstd_unordered_map_pair_size(sizeof(uint64_t),
+                                                            sizeof(uint64_t)),
+                        0, NULL);
+    fill_keys(keys, count);
+    bench_unordered_map("unordered_map churn (node pool)",
+                        cstd_node_pool_allocator(&pool), keys, count);
+    cstd_node_pool_free(&pool);
+
+    free(keys);
+    return 0;
+}
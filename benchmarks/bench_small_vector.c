@@ -0,0 +1,167 @@
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_common.h"
+#include "../cstd_small_vector.h"
+#include "../cstd_vector.h"
+
+/*
+ * vector_t against small_vector_t on workloads dominated by short
+ * vectors of 64-bit values, counting allocations with the counting
+ * allocator:
+ *
+ *  - request: each operation builds a vector of 0-4 values, reads it
+ *    back and frees it, like per-request scratch lists.
+ *  - value lists: values are appended to one vector per key with most
+ *    keys holding a handful of values, like the value lists of a
+ *    multimap; reports allocations and peak bytes per key.
+ *
+ * Usage: bench_small_vector [count]   (default 2000000)
+ */
+
+#define KEYS_PER_VALUE 4
+
+static void
+report_heap(size_t ops, const char* unit) {
+    printf("    %.3f allocations per %s, peak %zu bytes\n",
+           (double)bench_heap.allocations / (double)ops, unit,
+           bench_heap.peak_bytes);
+}
+
+static void
+reset_heap(void) {
+    bench_heap.allocations = 0;
+    bench_heap.live_bytes = 0;
+    bench_heap.peak_bytes = 0;
+}
+
+static void
+bench_request_vector(size_t count) {
+    uint64_t state = 42;
+    uint64_t sum = 0;
+    reset_heap();
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        vector_t vec;
+        size_t n = (size_t)(bench_rand(&state) % 5);
+        cstd_vector_init_with_allocator(&vec, sizeof(uint64_t),
+                                        &bench_counting_allocator);
+        for (size_t j = 0; j < n; j++) {
+            uint64_t value = i + j;
+            cstd_vector_push_back(&vec, &value);
+        }
+        for (size_t j = 0; j < vec.size; j++) {
+            sum += *(const uint64_t*)cstd_vector_at(&vec, j);
+        }
+        cstd_vector_free(&vec);
+    }
+    bench_report("request (vector_t)", count, bench_now() - start);
+    report_heap(count, "op");
+    if (sum == 0) {
+        printf("unexpected sum\n");
+    }
+}
+
+static void
+bench_request_small_vector(size_t count) {
+    uint64_t state = 42;
+    uint64_t sum = 0;
+    reset_heap();
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        small_vector_t vec;
+        size_t n = (size_t)(bench_rand(&state) % 5);
+        cstd_small_vector_init_with_allocator(&vec, sizeof(uint64_t),
+                                              &bench_counting_allocator);
+        for (size_t j = 0; j < n; j++) {
+            uint64_t value = i + j;
+            cstd_small_vector_push_back(&vec, &value);
+        }
+        for (size_t j = 0; j < vec.size; j++) {
+            sum += *(const uint64_t*)cstd_small_vector_at(&vec, j);
+        }
+        cstd_small_vector_free(&vec);
+    }
+    bench_report("request (small_vector_t)", count, bench_now() - start);
+    report_heap(count, "op");
+    if (sum == 0) {
+        printf("unexpected sum\n");
+    }
+}
+
+/*
+ * Picks the key of the next value: mostly uniform over all keys, with
+ * one value in 64 going to a small set of hot keys that grow long.
+ */
+static size_t
+next_key(uint64_t* state, size_t keys) {
+    uint64_t r = bench_rand(state);
+    if ((r & 63) == 0) {
+        return (size_t)((r >> 8) % 16);
+    }
+    return (size_t)((r >> 8) % keys);
+}
+
+static void
+bench_value_lists_vector(size_t count) {
+    size_t keys = count / KEYS_PER_VALUE;
+    vector_t* lists = (vector_t*)malloc(keys * sizeof(vector_t));
+    uint64_t state = 7;
+    if (!lists) {
+        return;
+    }
+    reset_heap();
+    double start = bench_now();
+    for (size_t i = 0; i < keys; i++) {
+        cstd_vector_init_with_allocator(&lists[i], sizeof(uint64_t),
+                                        &bench_counting_allocator);
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = i;
+        cstd_vector_push_back(&lists[next_key(&state, keys)], &value);
+    }
+    for (size_t i = 0; i < keys; i++) {
+        cstd_vector_free(&lists[i]);
+    }
+    bench_report("value lists (vector_t)", count, bench_now() - start);
+    report_heap(keys, "key");
+    printf("    %zu bytes of vector_t per key\n", sizeof(vector_t));
+    free(lists);
+}
+
+static void
+bench_value_lists_small_vector(size_t count) {
+    size_t keys = count / KEYS_PER_VALUE;
+    small_vector_t* lists =
+        (small_vector_t*)malloc(keys * sizeof(small_vector_t));
+    uint64_t state = 7;
+    if (!lists) {
+        return;
+    }
+    reset_heap();
+    double start = bench_now();
+    for (size_t i = 0; i < keys; i++) {
+        cstd_small_vector_init_with_allocator(&lists[i], sizeof(uint64_t),
+                                              &bench_counting_allocator);
+    }
+    for (size_t i = 0; i < count; i++) {
+        uint64_t value = i;
+        cstd_small_vector_push_back(&lists[next_key(&state, keys)], &value);
+    }
+    for (size_t i = 0; i < keys; i++) {
+        cstd_small_vector_free(&lists[i]);
+    }
+    bench_report("value lists (small_vector_t)", count, bench_now() - start);
+    report_heap(keys, "key");
+    printf("    %zu bytes of small_vector_t per key\n",
+           sizeof(small_vector_t));
+    free(lists);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 2000000);
+    printf("operations: %zu\n", count);
+    bench_request_vector(count);
+    bench_request_small_vector(count);
+    bench_value_lists_vector(count);
+    bench_value_lists_small_vector(count);
+    return 0;
+}
@@ -0,0 +1,114 @@
+#define BENCH_COUNT_ALLOCATIONS
+#include "bench_common.h"
+#include "../cstd_vector_mapped.h"
+
+/*
+ * Appending 32-bit elements to a vector_t one push_back at a time under
+ * each growth policy, against appending them in blocks with
+ * cstd_vector_append_n and cstd_vector_push_back_n, and pushing into a
+ * mapped vector, with and without huge pages, whose growth commits
+ * memory in place. Reports the number of allocator calls and the final
+ * capacity with each result.
+ *
+ * Usage: bench_vector [count]   (default 10000000)
+ */
+
+#define BLOCK 1024
+
+static const char* growth_names[] = { "1.5x", "2x", "page" };
+
+static void
+report(const char* name, const vector_t* vec, size_t count, double seconds) {
+    bench_report(name, count, seconds);
+    printf("    %zu allocations, capacity %zu\n",
+           bench_heap.allocations, vec->capacity);
+}
+
+static void
+bench_push_back(cstd_vector_growth_t growth, size_t count) {
+    char name[64];
+    vector_t vec;
+    bench_heap.allocations = 0;
+    cstd_vector_init_with_allocator(&vec, sizeof(uint32_t),
+                                    &bench_counting_allocator);
+    cstd_vector_set_growth(&vec, growth);
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = (uint32_t)i;
+        cstd_vector_push_back(&vec, &value);
+    }
+    double seconds = bench_now() - start;
+    snprintf(name, sizeof(name), "vector push_back (%s)", growth_names[growth]);
+    report(name, &vec, count, seconds);
+    cstd_vector_free(&vec);
+}
+
+static void
+bench_append_n(const uint32_t* block, size_t count) {
+    vector_t vec;
+    bench_heap.allocations = 0;
+    cstd_vector_init_with_allocator(&vec, sizeof(uint32_t),
+                                    &bench_counting_allocator);
+    double start = bench_now();
+    for (size_t i = 0; i < count; i += BLOCK) {
+        size_t n = count - i < BLOCK ? count - i : BLOCK;
+        cstd_vector_append_n(&vec, block, n);
+    }
+    report("vector append_n (1.5x)", &vec, count, bench_now() - start);
+    cstd_vector_free(&vec);
+}
+
+static void
+bench_push_back_n(size_t count) {
+    vector_t vec;
+    uint32_t value = 7;
+    bench_heap.allocations = 0;
+    cstd_vector_init_with_allocator(&vec, sizeof(uint32_t),
+                                    &bench_counting_allocator);
+    double start = bench_now();
+    for (size_t i = 0; i < count; i += BLOCK) {
+        size_t n = count - i < BLOCK ? count - i : BLOCK;
+        cstd_vector_push_back_n(&vec, &value, n);
+    }
+    report("vector push_back_n (1.5x)", &vec, count, bench_now() - start);
+    cstd_vector_free(&vec);
+}
+
+static void
+bench_mapped(bool huge_pages, size_t count) {
+    char name[64];
+    vector_t vec;
+    bench_heap.allocations = 0;
+    if (!cstd_vector_init_mapped(&vec, sizeof(uint32_t), count, huge_pages)) {
+        printf("mapped vector unavailable\n");
+        return;
+    }
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = (uint32_t)i;
+        cstd_vector_push_back(&vec, &value);
+    }
+    double seconds = bench_now() - start;
+    snprintf(name, sizeof(name), "vector push_back (mapped%s)",
+             huge_pages ? ", huge pages" : "");
+    report(name, &vec, count, seconds);
+    cstd_vector_free(&vec);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 10000000);
+    uint32_t block[BLOCK];
+    for (size_t i = 0; i < BLOCK; i++) {
+        block[i] = (uint32_t)i;
+    }
+
+    printf("elements: %zu, block: %d\n", count, BLOCK);
+    bench_push_back(CSTD_VECTOR_GROWTH_1_5X, count);
+    bench_push_back(CSTD_VECTOR_GROWTH_2X, count);
+    bench_push_back(CSTD_VECTOR_GROWTH_PAGE, count);
+    bench_append_n(block, count);
+    bench_push_back_n(count);
+    bench_mapped(false, count);
+    bench_mapped(true, count);
+    return 0;
+}
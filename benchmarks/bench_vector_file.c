@@ -0,0 +1,103 @@
+#include "bench_common.h"
+#include "../cstd_vector_file.h"
+
+/*
+ * Loading a saved vector of 64-byte records: reading the file with
+ * fread and a cstd_vector_push_back per record, against reopening a
+ * file-backed vector with cstd_vector_open_file. Both loads are
+ * followed by one pass over the records, which for the mapped file
+ * reads through the page cache.
+ *
+ * Usage: bench_vector_file [count]   (default 1000000)
+ */
+
+#define STREAM_PATH "bench_vector_file.dat"
+#define MAPPED_PATH "bench_vector_file.vec"
+
+typedef struct {
+    uint64_t id;
+    uint64_t fields[7];
+} record_t;
+
+static uint64_t
+sum_records(vector_t* vec) {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < vec->size; i++) {
+        sum += ((const record_t*)cstd_vector_at(vec, i))->id;
+    }
+    return sum;
+}
+
+static void
+bench_stream(size_t count) {
+    record_t record = {0};
+    FILE* out = fopen(STREAM_PATH, "wb");
+    if (!out) {
+        return;
+    }
+    for (size_t i = 0; i < count; i++) {
+        record.id = i;
+        fwrite(&record, sizeof(record), 1, out);
+    }
+    fclose(out);
+
+    vector_t vec;
+    double start = bench_now();
+    FILE* in = fopen(STREAM_PATH, "rb");
+    cstd_vector_init(&vec, sizeof(record_t));
+    while (fread(&record, sizeof(record), 1, in) == 1) {
+        cstd_vector_push_back(&vec, &record);
+    }
+    fclose(in);
+    double loaded = bench_now();
+    uint64_t sum = sum_records(&vec);
+    double seconds = bench_now() - start;
+    bench_report("fread + push_back load", count, loaded - start);
+    bench_report("fread + push_back load and scan", count, seconds);
+    if (sum != (uint64_t)count * (count - 1) / 2) {
+        printf("unexpected sum\n");
+    }
+    cstd_vector_free(&vec);
+    remove(STREAM_PATH);
+}
+
+static void
+bench_mapped(size_t count) {
+    record_t record = {0};
+    vector_t vec;
+    remove(MAPPED_PATH);
+    if (!cstd_vector_open_file(&vec, MAPPED_PATH, sizeof(record_t))) {
+        printf("cannot open %s\n", MAPPED_PATH);
+        return;
+    }
+    cstd_vector_reserve(&vec, count);
+    for (size_t i = 0; i < count; i++) {
+        record.id = i;
+        cstd_vector_push_back(&vec, &record);
+    }
+    cstd_vector_close_file(&vec);
+
+    double start = bench_now();
+    if (!cstd_vector_open_file(&vec, MAPPED_PATH, sizeof(record_t))) {
+        printf("cannot reopen %s\n", MAPPED_PATH);
+        return;
+    }
+    double loaded = bench_now();
+    uint64_t sum = sum_records(&vec);
+    double seconds = bench_now() - start;
+    bench_report("open_file load", count, loaded - start);
+    bench_report("open_file load and scan", count, seconds);
+    if (sum != (uint64_t)count * (count - 1) / 2) {
+        printf("unexpected sum\n");
+    }
+    cstd_vector_close_file(&vec);
+    remove(MAPPED_PATH);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    printf("records: %zu of %zu bytes\n", count, sizeof(record_t));
+    bench_stream(count);
+    bench_mapped(count);
+    return 0;
+}
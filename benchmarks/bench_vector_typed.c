@@ -0,0 +1,93 @@
+#include "bench_common.h"
+#include "../cstd_vector.h"
+
+/*
+ * A typed vector from CSTD_VECTOR_DEFINE against vector_t, with 32-bit
+ * elements: appending with push_back, random positional reads with at,
+ * and summing every element in order, through cstd_vector_at for
+ * vector_t and through the typed data array, which the compiler can
+ * vectorize, for the typed vector.
+ *
+ * Usage: bench_vector_typed [count]   (default 1000000)
+ */
+
+CSTD_VECTOR_DEFINE(u32_vector, uint32_t)
+
+#define PASSES 100
+
+static void
+bench_untyped(size_t count) {
+    vector_t vec;
+    uint64_t state = 42;
+    uint64_t sum = 0;
+
+    cstd_vector_init(&vec, sizeof(uint32_t));
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        uint32_t value = (uint32_t)i;
+        cstd_vector_push_back(&vec, &value);
+    }
+    bench_report("push_back (vector_t)", count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        size_t index = (size_t)(bench_rand(&state) % count);
+        sum += *(const uint32_t*)cstd_vector_at(&vec, index);
+    }
+    bench_report("at (vector_t)", count, bench_now() - start);
+
+    start = bench_now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < cstd_vector_size(&vec); i++) {
+            sum += *(const uint32_t*)cstd_vector_at(&vec, i);
+        }
+    }
+    bench_report("iterate (vector_t)", PASSES * count, bench_now() - start);
+
+    if (sum == 0) {
+        printf("unexpected sum\n");
+    }
+    cstd_vector_free(&vec);
+}
+
+static void
+bench_typed(size_t count) {
+    u32_vector_t vec;
+    uint64_t state = 42;
+    uint64_t sum = 0;
+
+    u32_vector_init(&vec);
+    double start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        u32_vector_push_back(&vec, (uint32_t)i);
+    }
+    bench_report("push_back (typed)", count, bench_now() - start);
+
+    start = bench_now();
+    for (size_t i = 0; i < count; i++) {
+        size_t index = (size_t)(bench_rand(&state) % count);
+        sum += *u32_vector_at(&vec, index);
+    }
+    bench_report("at (typed)", count, bench_now() - start);
+
+    start = bench_now();
+    for (int pass = 0; pass < PASSES; pass++) {
+        for (size_t i = 0; i < vec.size; i++) {
+            sum += vec.data[i];
+        }
+    }
+    bench_report("iterate (typed)", PASSES * count, bench_now() - start);
+
+    if (sum == 0) {
+        printf("unexpected sum\n");
+    }
+    u32_vector_free(&vec);
+}
+
+int main(int argc, char** argv) {
+    size_t count = bench_arg_count(argc, argv, 1000000);
+    printf("elements: %zu\n", count);
+    bench_untyped(count);
+    bench_typed(count);
+    return 0;
+}
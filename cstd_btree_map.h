@@ -0,0 +1,482 @@
+#pragma once
+
+#include "cstd_common.h"
+
+/* Bytes of keys held by one node, the rest of the node follows them */
+#define BTREE_MAP_NODE_KEY_BYTES (4 * CSTD_CACHE_LINE_SIZE)
+
+/*
+ * A B-tree node. Keys, values and (for internal nodes) child pointers
+ * are stored inline behind the header as three arrays, at the offsets
+ * recorded in the map. Keys come first so that the in-node search only
+ * touches a few consecutive cache lines. Leaves are allocated without
+ * the child array.
+ */
+typedef struct btree_map_node_t {
+    uint32_t count;
+    bool     leaf;
+} btree_map_node_t;
+
+/*
+ * Ordered map backed by a B-tree of minimum degree t: every node but the
+ * root holds between t - 1 and 2t - 1 keys. t is picked from the key size
+ * so that the keys of a node fill BTREE_MAP_NODE_KEY_BYTES, which keeps
+ * the tree a handful of levels deep even for very large maps.
+ */
+typedef struct btree_map_t {
+    btree_map_node_t* root;
+    size_t            size;
+    size_t            key_size;
+    size_t            value_size;
+    size_t            min_degree;
+    size_t            keys_offset;
+    size_t            values_offset;
+    size_t            children_offset;
+    size_t            leaf_size;
+    size_t            internal_size;
+    int32_t (*key_compare)(const void *, const void *);
+    const cstd_allocator_t* allocator;
+} btree_map_t;
+
+cstd_inline void*
+cstd_btree_map_key(const btree_map_t* map, btree_map_node_t* node,
+                   const size_t index) {
+    return (unsigned char*)node + map->keys_offset + index * map->key_size;
+}
+
+cstd_inline void*
+cstd_btree_map_value(const btree_map_t* map, btree_map_node_t* node,
+                     const size_t index) {
+    return (unsigned char*)node + map->values_offset +
+           index * map->value_size;
+}
+
+cstd_inline btree_map_node_t**
+cstd_btree_map_children(const btree_map_t* map, btree_map_node_t* node) {
+    return (btree_map_node_t**)((unsigned char*)node + map->children_offset);
+}
+
+cstd_inline btree_map_node_t*
+cstd_btree_map_new_node(const btree_map_t* map, const bool leaf) {
+    btree_map_node_t* node = (btree_map_node_t*)cstd_alloc(
+        map->allocator, leaf ? map->leaf_size : map->internal_size);
+    if (!node) {
+        return NULL;
+    }
+    node->count = 0;
+    node->leaf = leaf;
+    return node;
+}
+
+cstd_inline void
+cstd_btree_map_delete_node(const btree_map_t* map, btree_map_node_t* node) {
+    cstd_free(map->allocator, node,
+              node->leaf ? map->leaf_size : map->internal_size);
+}
+
+/*
+ * Returns the index of the first key in node that is not less than key,
+ * and sets found if that key is equal. The loop halves the range without
+ * branching on the comparison, so it compiles to a conditional move.
+ */
+cstd_inline size_t
+cstd_btree_map_search(const btree_map_t* map, btree_map_node_t* node,
+                      const void* key, bool* found) {
+    size_t count = node->count;
+    if (count == 0) {
+        *found = false;
+        return 0;
+    }
+    size_t base = 0;
+    while (count > 1) {
+        size_t half = count / 2;
+        int32_t cmp =
+            map->key_compare(cstd_btree_map_key(map, node, base + half), key);
+        base = (cmp < 0) ? base + half : base;
+        count -= half;
+    }
+    int32_t cmp = map->key_compare(cstd_btree_map_key(map, node, base), key);
+    if (cmp < 0) {
+        base++;
+        cmp = (base < node->count)
+            ? map->key_compare(cstd_btree_map_key(map, node, base), key)
+            : 1;
+    }
+    *found = (cmp == 0);
+    return base;
+}
+
+/*
+ * Moves count entries of node starting at from to start at to. Entries
+ * may overlap.
+ */
+cstd_inline void
+cstd_btree_map_move_entries(const btree_map_t* map, btree_map_node_t* dest,
+                            const size_t to, btree_map_node_t* src,
+                            const size_t from, const size_t count) {
+    memmove(cstd_btree_map_key(map, dest, to),
+            cstd_btree_map_key(map, src, from), count * map->key_size);
+    memmove(cstd_btree_map_value(map, dest, to),
+            cstd_btree_map_value(map, src, from), count * map->value_size);
+}
+
+cstd_inline void
+cstd_btree_map_move_children(const btree_map_t* map, btree_map_node_t* dest,
+                             const size_t to, btree_map_node_t* src,
+                             const size_t from, const size_t count) {
+    memmove(cstd_btree_map_children(map, dest) + to,
+            cstd_btree_map_children(map, src) + from,
+            count * sizeof(btree_map_node_t*));
+}
+
+/*
+ * Initialize a map whose nodes are allocated from allocator, or with
+ * malloc when allocator is NULL.
+ */
+cstd_inline void
+cstd_btree_map_init_with_allocator(
+    btree_map_t* map, const size_t key_size, const size_t value_size,
+    int32_t (*key_compare)(const void *, const void *),
+    const cstd_allocator_t* allocator) {
+    size_t max_keys = key_size ? BTREE_MAP_NODE_KEY_BYTES / key_size : 3;
+    if (max_keys < 3) {
+        max_keys = 3;
+    }
+    if (max_keys % 2 == 0) {
+        max_keys--;
+    }
+
+    map->root = NULL;
+    map->size = 0;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->key_compare = key_compare;
+    map->allocator = cstd_allocator_or_default(allocator);
+    map->min_degree = (max_keys + 1) / 2;
+    map->keys_offset = cstd_align_up(sizeof(btree_map_node_t),
+                                     cstd_size_alignment(key_size));
+    map->values_offset = cstd_align_up(map->keys_offset + max_keys * key_size,
+                                       cstd_size_alignment(value_size));
+    map->children_offset =
+        cstd_align_up(map->values_offset + max_keys * value_size,
+                      sizeof(btree_map_node_t*));
+    map->leaf_size = map->values_offset + max_keys * value_size;
+    map->internal_size = map->children_offset +
+                         (max_keys + 1) * sizeof(btree_map_node_t*);
+}
+
+cstd_inline void
+cstd_btree_map_init(btree_map_t* map,
+                    const size_t key_size,
+                    const size_t value_size,
+                    int32_t (*key_compare)(const void *, const void *)) {
+    cstd_btree_map_init_with_allocator(map, key_size, value_size,
+                                       key_compare, NULL);
+}
+
+/*
+ * Splits the full child at index of parent around its median, which
+ * moves up into parent. parent must not be full. Returns false if
+ * allocation fails.
+ */
+cstd_inline bool
+cstd_btree_map_split_child(btree_map_t* map, btree_map_node_t* parent,
+                           const size_t index) {
+    size_t t = map->min_degree;
+    btree_map_node_t* child = cstd_btree_map_children(map, parent)[index];
+    btree_map_node_t* sibling = cstd_btree_map_new_node(map, child->leaf);
+    if (!sibling) {
+        return false;
+    }
+
+    cstd_btree_map_move_entries(map, sibling, 0, child, t, t - 1);
+    if (!child->leaf) {
+        cstd_btree_map_move_children(map, sibling, 0, child, t, t);
+    }
+    sibling->count = (uint32_t)(t - 1);
+    child->count = (uint32_t)(t - 1);
+
+    cstd_btree_map_move_children(map, parent, index + 2, parent, index + 1,
+                                 parent->count - index);
+    cstd_btree_map_children(map, parent)[index + 1] = sibling;
+    cstd_btree_map_move_entries(map, parent, index + 1, parent, index,
+                                parent->count - index);
+    cstd_btree_map_move_entries(map, parent, index, child, t - 1, 1);
+    parent->count++;
+    return true;
+}
+
+/*
+ * Inserts key with value, or overwrites the value if key is present.
+ * Full nodes are split on the way down, so the insert is a single pass
+ * from the root to a leaf.
+ */
+cstd_inline void
+cstd_btree_map_insert(btree_map_t* map, const void* key, const void* value) {
+    size_t max_keys = 2 * map->min_degree - 1;
+
+    if (!map->root) {
+        map->root = cstd_btree_map_new_node(map, true);
+        if (!map->root) {
+            return;
+        }
+    }
+    if (map->root->count == max_keys) {
+        btree_map_node_t* root = cstd_btree_map_new_node(map, false);
+        if (!root) {
+            return;
+        }
+        cstd_btree_map_children(map, root)[0] = map->root;
+        if (!cstd_btree_map_split_child(map, root, 0)) {
+            cstd_btree_map_delete_node(map, root);
+            return;
+        }
+        map->root = root;
+    }
+
+    btree_map_node_t* node = map->root;
+    for (;;) {
+        bool found;
+        size_t index = cstd_btree_map_search(map, node, key, &found);
+        if (found) {
+            memcpy(cstd_btree_map_value(map, node, index), value,
+                   map->value_size);
+            return;
+        }
+        if (node->leaf) {
+            cstd_btree_map_move_entries(map, node, index + 1, node, index,
+                                        node->count - index);
+            memcpy(cstd_btree_map_key(map, node, index), key, map->key_size);
+            memcpy(cstd_btree_map_value(map, node, index), value,
+                   map->value_size);
+            node->count++;
+            map->size++;
+            return;
+        }
+
+        btree_map_node_t* child = cstd_btree_map_children(map, node)[index];
+        if (child->count == max_keys) {
+            if (!cstd_btree_map_split_child(map, node, index)) {
+                return;
+            }
+            int32_t cmp =
+                map->key_compare(key, cstd_btree_map_key(map, node, index));
+            if (cmp == 0) {
+                memcpy(cstd_btree_map_value(map, node, index), value,
+                       map->value_size);
+                return;
+            }
+            if (cmp > 0) {
+                index++;
+            }
+            child = cstd_btree_map_children(map, node)[index];
+        }
+        node = child;
+    }
+}
+
+cstd_inline void*
+cstd_btree_map_find(btree_map_t* map, const void* key) {
+    btree_map_node_t* node = map->root;
+    while (node) {
+        bool found;
+        size_t index = cstd_btree_map_search(map, node, key, &found);
+        if (found) {
+            return cstd_btree_map_value(map, node, index);
+        }
+        if (node->leaf) {
+            return NULL;
+        }
+        node = cstd_btree_map_children(map, node)[index];
+    }
+    return NULL;
+}
+
+/*
+ * Merges the child at index + 1 of parent and the separating key into
+ * the child at index, then frees the emptied child. Both children must
+ * hold t - 1 keys.
+ */
+cstd_inline void
+cstd_btree_map_merge_children(btree_map_t* map, btree_map_node_t* parent,
+                              const size_t index) {
+    btree_map_node_t** children = cstd_btree_map_children(map, parent);
+    btree_map_node_t* left = children[index];
+    btree_map_node_t* right = children[index + 1];
+
+    cstd_btree_map_move_entries(map, left, left->count, parent, index, 1);
+    cstd_btree_map_move_entries(map, left, left->count + 1, right, 0,
+                                right->count);
+    if (!left->leaf) {
+        cstd_btree_map_move_children(map, left, left->count + 1, right, 0,
+                                     right->count + 1);
+    }
+    left->count += right->count + 1;
+
+    cstd_btree_map_move_entries(map, parent, index, parent, index + 1,
+                                parent->count - index - 1);
+    cstd_btree_map_move_children(map, parent, index + 1, parent, index + 2,
+                                 parent->count - index - 1);
+    parent->count--;
+    cstd_btree_map_delete_node(map, right);
+}
+
+/*
+ * Makes sure the child at index of parent holds at least t keys before
+ * the delete descends into it, by borrowing a key through the parent
+ * from a sibling or by merging with one. Returns the child to descend
+ * into, which is the left node if a merge with the left sibling happened.
+ */
+cstd_inline btree_map_node_t*
+cstd_btree_map_fill_child(btree_map_t* map, btree_map_node_t* parent,
+                          const size_t index) {
+    size_t t = map->min_degree;
+    btree_map_node_t** children = cstd_btree_map_children(map, parent);
+    btree_map_node_t* child = children[index];
+
+    if (index > 0 && children[index - 1]->count >= t) {
+        btree_map_node_t* left = children[index - 1];
+        cstd_btree_map_move_entries(map, child, 1, child, 0, child->count);
+        cstd_btree_map_move_entries(map, child, 0, parent, index - 1, 1);
+        cstd_btree_map_move_entries(map, parent, index - 1, left,
+                                    left->count - 1, 1);
+        if (!child->leaf) {
+            cstd_btree_map_move_children(map, child, 1, child, 0,
+                                         child->count + 1);
+            cstd_btree_map_children(map, child)[0] =
+                cstd_btree_map_children(map, left)[left->count];
+        }
+        child->count++;
+        left->count--;
+        return child;
+    }
+
+    if (index < parent->count && children[index + 1]->count >= t) {
+        btree_map_node_t* right = children[index + 1];
+        cstd_btree_map_move_entries(map, child, child->count, parent, index, 1);
+        cstd_btree_map_move_entries(map, parent, index, right, 0, 1);
+        if (!child->leaf) {
+            cstd_btree_map_children(map, child)[child->count + 1] =
+                cstd_btree_map_children(map, right)[0];
+            cstd_btree_map_move_children(map, right, 0, right, 1,
+                                         right->count);
+        }
+        cstd_btree_map_move_entries(map, right, 0, right, 1,
+                                    right->count - 1);
+        child->count++;
+        right->count--;
+        return child;
+    }
+
+    if (index < parent->count) {
+        cstd_btree_map_merge_children(map, parent, index);
+        return child;
+    }
+    cstd_btree_map_merge_children(map, parent, index - 1);
+    return children[index - 1];
+}
+
+/*
+ * Removes key from the map if present. Like insert, this is a single
+ * pass: every node entered on the way down already holds at least t
+ * keys, so removing one never needs to walk back up.
+ */
+cstd_inline void
+cstd_btree_map_delete(btree_map_t* map, const void* key) {
+    size_t t = map->min_degree;
+    btree_map_node_t* node = map->root;
+
+    while (node) {
+        bool found;
+        size_t index = cstd_btree_map_search(map, node, key, &found);
+
+        if (found && node->leaf) {
+            cstd_btree_map_move_entries(map, node, index, node, index + 1,
+                                        node->count - index - 1);
+            node->count--;
+            map->size--;
+            break;
+        }
+
+        if (found) {
+            btree_map_node_t** children = cstd_btree_map_children(map, node);
+            btree_map_node_t* left = children[index];
+            btree_map_node_t* right = children[index + 1];
+
+            if (left->count >= t) {
+                // Replace the key by its predecessor, then delete that
+                btree_map_node_t* leaf = left;
+                while (!leaf->leaf) {
+                    leaf = cstd_btree_map_children(map, leaf)[leaf->count];
+                }
+                cstd_btree_map_move_entries(map, node, index, leaf,
+                                            leaf->count - 1, 1);
+                key = cstd_btree_map_key(map, node, index);
+                node = left;
+            } else if (right->count >= t) {
+                // Replace the key by its successor, then delete that
+                btree_map_node_t* leaf = right;
+                while (!leaf->leaf) {
+                    leaf = cstd_btree_map_children(map, leaf)[0];
+                }
+                cstd_btree_map_move_entries(map, node, index, leaf, 0, 1);
+                key = cstd_btree_map_key(map, node, index);
+                node = right;
+            } else {
+                cstd_btree_map_merge_children(map, node, index);
+                node = left;
+            }
+            continue;
+        }
+
+        if (node->leaf) {
+            break;
+        }
+        btree_map_node_t* child = cstd_btree_map_children(map, node)[index];
+        if (child->count < t) {
+            child = cstd_btree_map_fill_child(map, node, index);
+        }
+        node = child;
+    }
+
+    btree_map_node_t* root = map->root;
+    if (root && root->count == 0) {
+        map->root = root->leaf ? NULL : cstd_btree_map_children(map, root)[0];
+        cstd_btree_map_delete_node(map, root);
+    }
+}
+
+cstd_inline void
+cstd_btree_map_free_node(btree_map_t* map, btree_map_node_t* node) {
+    if (!node->leaf) {
+        btree_map_node_t** children = cstd_btree_map_children(map, node);
+        for (size_t i = 0; i <= node->count; i++) {
+            cstd_btree_map_free_node(map, children[i]);
+        }
+    }
+    cstd_btree_map_delete_node(map, node);
+}
+
+cstd_inline size_t
+cstd_btree_map_size(btree_map_t* map) {
+    return map->size;
+}
+
+cstd_inline bool
+cstd_btree_map_empty(btree_map_t* map) {
+    return map->size == 0;
+}
+
+cstd_inline void
+cstd_btree_map_clear(btree_map_t* map) {
+    if (map->root) {
+        cstd_btree_map_free_node(map, map->root);
+    }
+    map->root = NULL;
+    map->size = 0;
+}
+
+cstd_inline void
+cstd_btree_map_free(btree_map_t* map) {
+    cstd_btree_map_clear(map);
+}
@@ -26,6 +26,9 @@
     #error "Compiler not supported."
 #endif
 
+/* Size of a cache line, used to keep shared data on separate lines */
+#define CSTD_CACHE_LINE_SIZE 64
+
 #if defined(__GNUC__) || defined(__clang__)
     #define cstd_packed __attribute__((packed))
 #elif defined(_MSC_VER)
@@ -49,3 +52,349 @@
 #else
     #error "Compiler not supported."
 #endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define cstd_prefetch(addr) __builtin_prefetch((addr), 0, 3)
+#elif defined(_MSC_VER)
+    #include <intrin.h>
+    #define cstd_prefetch(addr) _mm_prefetch((const char*)(addr), _MM_HINT_T0)
+#else
+    #error "Compiler not supported."
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define cstd_ctz32(x) ((uint32_t)__builtin_ctz(x))
+#elif defined(_MSC_VER)
+    #include <intrin.h>
+    cstd_inline uint32_t cstd_ctz32(uint32_t x) {
+        unsigned long index;
+        _BitScanForward(&index, x);
+        return (uint32_t)index;
+    }
+#else
+    #error "Compiler not supported."
+#endif
+
+/*
+ * Returns the natural alignment of an object of the given size: the
+ * largest power of two dividing it, capped at 16 bytes.
+ */
+cstd_inline size_t
+cstd_size_alignment(const size_t size) {
+    size_t alignment = size & (~size + 1);
+    if (alignment == 0 || alignment > 16) {
+        alignment = 16;
+    }
+    return alignment;
+}
+
+/*
+ * Rounds n up to the next multiple of alignment, which must be a power
+ * of two.
+ */
+cstd_inline size_t
+cstd_align_up(const size_t n, const size_t alignment) {
+    return (n + alignment - 1) & ~(alignment - 1);
+}
+
+/*
+ * Finalizer from MurmurHash3. Spreads the entropy of a user supplied
+ * hash over all 32 bits so that the low bits can be used as a bucket
+ * index.
+ */
+cstd_inline uint32_t
+cstd_hash_mix32(uint32_t hash) {
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+    return hash;
+}
+
+/*
+ * Size_t counterpart of cstd_hash_mix32, using the 64-bit MurmurHash3
+ * finalizer where size_t is 64 bits wide.
+ */
+cstd_inline size_t
+cstd_hash_mix_size(size_t hash) {
+#if SIZE_MAX > UINT32_MAX
+    uint64_t h = (uint64_t)hash;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return (size_t)h;
+#else
+    return (size_t)cstd_hash_mix32((uint32_t)hash);
+#endif
+}
+
+/*
+ * Returns the smallest power of two that is greater than or equal to n,
+ * or 1 when n is 0.
+ */
+cstd_inline size_t
+cstd_next_pow2(size_t n) {
+    size_t pow2 = 1;
+    while (pow2 < n) {
+        pow2 <<= 1;
+    }
+    return pow2;
+}
+
+/*
+ * Allocator interface used by every container. The callbacks receive
+ * the context pointer along with the size of the block, so pools and
+ * arenas can route blocks by size without a header of their own. A
+ * container initialized with a NULL allocator uses malloc, realloc and
+ * free.
+ */
+typedef struct cstd_allocator_t {
+    void* (*allocate)(void* context, size_t size);
+    void* (*reallocate)(void* context, void* data, size_t old_size,
+                        size_t new_size);
+    void  (*deallocate)(void* context, void* data, size_t size);
+    void*   context;
+} cstd_allocator_t;
+
+cstd_inline void*
+cstd_default_allocate(void* context, size_t size) {
+    cstd_unused(context);
+    return malloc(size);
+}
+
+cstd_inline void*
+cstd_default_reallocate(void* context, void* data, size_t old_size,
+                        size_t new_size) {
+    cstd_unused(context);
+    cstd_unused(old_size);
+    return realloc(data, new_size);
+}
+
+cstd_inline void
+cstd_default_deallocate(void* context, void* data, size_t size) {
+    cstd_unused(context);
+    cstd_unused(size);
+    free(data);
+}
+
+static const cstd_allocator_t cstd_default_allocator = {
+    cstd_default_allocate,
+    cstd_default_reallocate,
+    cstd_default_deallocate,
+    NULL
+};
+
+/*
+ * Returns allocator, or the malloc based default when it is NULL.
+ */
+cstd_inline const cstd_allocator_t*
+cstd_allocator_or_default(const cstd_allocator_t* allocator) {
+    return allocator ? allocator : &cstd_default_allocator;
+}
+
+cstd_inline void*
+cstd_alloc(const cstd_allocator_t* allocator, size_t size) {
+    return allocator->allocate(allocator->context, size);
+}
+
+cstd_inline void*
+cstd_calloc(const cstd_allocator_t* allocator, size_t count, size_t size) {
+    void* data = allocator->allocate(allocator->context, count * size);
+    if (data) {
+        memset(data, 0, count * size);
+    }
+    return data;
+}
+
+cstd_inline void*
+cstd_realloc(const cstd_allocator_t* allocator, void* data,
+             size_t old_size, size_t new_size) {
+    if (!data) {
+        return allocator->allocate(allocator->context, new_size);
+    }
+    return allocator->reallocate(allocator->context, data, old_size,
+                                 new_size);
+}
+
+/*
+ * Releases a block of the given size. NULL is ignored.
+ */
+cstd_inline void
+cstd_free(const cstd_allocator_t* allocator, void* data, size_t size) {
+    if (data) {
+        allocator->deallocate(allocator->context, data, size);
+    }
+}
+
+/* Alignment of every node handed out by a cstd_node_pool_t */
+#define CSTD_NODE_POOL_ALIGNMENT 16
+
+/* Default number of nodes carved out of one pool chunk */
+#define CSTD_NODE_POOL_CHUNK_NODES 256
+
+typedef struct cstd_node_pool_chunk_t {
+    struct cstd_node_pool_chunk_t* next;
+    size_t                         size;
+} cstd_node_pool_chunk_t;
+
+/*
+ * Fixed-size node pool. Nodes are carved out of large chunks obtained
+ * from a parent allocator and recycled through an intrusive free list,
+ * so allocating and freeing a node are both O(1) and touch no allocator
+ * lock. Chunks are only returned to the parent, all at once, by
+ * cstd_node_pool_free.
+ *
+ * The pool is also a cstd_allocator_t: cstd_node_pool_allocator returns
+ * an allocator that serves blocks of exactly node_size bytes from the
+ * pool and passes every other size through to the parent. A node
+ * container opts in by being initialized with that allocator, and the
+ * node containers provide a _node_size function giving the size to
+ * create the pool with. Several containers with the same node size may
+ * share a pool. The pool is not thread-safe and must not move while a
+ * container uses it.
+ */
+typedef struct {
+    cstd_allocator_t        allocator;
+    const cstd_allocator_t* parent;
+    size_t                  node_size;
+    size_t                  slot_size;
+    size_t                  chunk_nodes;
+    void*                   free_list;
+    cstd_node_pool_chunk_t* chunks;
+    unsigned char*          cursor;
+    unsigned char*          end;
+} cstd_node_pool_t;
+
+cstd_inline size_t
+cstd_node_pool_header_size(void) {
+    return cstd_align_up(sizeof(cstd_node_pool_chunk_t),
+                         CSTD_NODE_POOL_ALIGNMENT);
+}
+
+/*
+ * Returns a node of node_size bytes, or NULL if the parent allocator
+ * fails.
+ */
+cstd_inline void*
+cstd_node_pool_alloc(cstd_node_pool_t* pool) {
+    if (pool->free_list) {
+        void* node = pool->free_list;
+        pool->free_list = *(void**)node;
+        return node;
+    }
+    if (pool->cursor == pool->end) {
+        size_t size = cstd_node_pool_header_size() +
+                      pool->chunk_nodes * pool->slot_size;
+        cstd_node_pool_chunk_t* chunk =
+            (cstd_node_pool_chunk_t*)cstd_alloc(pool->parent, size);
+        if (!chunk) {
+            return NULL;
+        }
+        chunk->next = pool->chunks;
+        chunk->size = size;
+        pool->chunks = chunk;
+        pool->cursor = (unsigned char*)chunk + cstd_node_pool_header_size();
+        pool->end = (unsigned char*)chunk + size;
+    }
+    void* node = pool->cursor;
+    pool->cursor += pool->slot_size;
+    return node;
+}
+
+/*
+ * Returns a node obtained from cstd_node_pool_alloc to the pool.
+ */
+cstd_inline void
+cstd_node_pool_release(cstd_node_pool_t* pool, void* node) {
+    *(void**)node = pool->free_list;
+    pool->free_list = node;
+}
+
+cstd_inline void*
+cstd_node_pool_allocate(void* context, size_t size) {
+    cstd_node_pool_t* pool = (cstd_node_pool_t*)context;
+    if (size == pool->node_size) {
+        return cstd_node_pool_alloc(pool);
+    }
+    return cstd_alloc(pool->parent, size);
+}
+
+cstd_inline void
+cstd_node_pool_deallocate(void* context, void* data, size_t size) {
+    cstd_node_pool_t* pool = (cstd_node_pool_t*)context;
+    if (size == pool->node_size) {
+        cstd_node_pool_release(pool, data);
+    } else {
+        cstd_free(pool->parent, data, size);
+    }
+}
+
+cstd_inline void*
+cstd_node_pool_reallocate(void* context, void* data, size_t old_size,
+                          size_t new_size) {
+    cstd_node_pool_t* pool = (cstd_node_pool_t*)context;
+    if (old_size != pool->node_size && new_size != pool->node_size) {
+        return cstd_realloc(pool->parent, data, old_size, new_size);
+    }
+    void* moved = cstd_node_pool_allocate(pool, new_size);
+    if (moved) {
+        memcpy(moved, data, old_size < new_size ? old_size : new_size);
+        cstd_node_pool_deallocate(pool, data, old_size);
+    }
+    return moved;
+}
+
+/*
+ * Initialize a pool of node_size byte nodes, allocated chunk_nodes at a
+ * time (CSTD_NODE_POOL_CHUNK_NODES when 0) from parent, or with malloc
+ * when parent is NULL. No memory is allocated until the first node.
+ */
+cstd_inline void
+cstd_node_pool_init(cstd_node_pool_t* pool, size_t node_size,
+                    size_t chunk_nodes, const cstd_allocator_t* parent) {
+    pool->allocator.allocate = cstd_node_pool_allocate;
+    pool->allocator.reallocate = cstd_node_pool_reallocate;
+    pool->allocator.deallocate = cstd_node_pool_deallocate;
+    pool->allocator.context = pool;
+    pool->parent = cstd_allocator_or_default(parent);
+    pool->node_size = node_size;
+    pool->slot_size = cstd_align_up(
+        node_size > sizeof(void*) ? node_size : sizeof(void*),
+        CSTD_NODE_POOL_ALIGNMENT);
+    pool->chunk_nodes = chunk_nodes ? chunk_nodes : CSTD_NODE_POOL_CHUNK_NODES;
+    pool->free_list = NULL;
+    pool->chunks = NULL;
+    pool->cursor = NULL;
+    pool->end = NULL;
+}
+
+/*
+ * Returns the allocator that routes node_size blocks to the pool, for
+ * passing to the _init_with_allocator functions of the containers.
+ */
+cstd_inline const cstd_allocator_t*
+cstd_node_pool_allocator(const cstd_node_pool_t* pool) {
+    return &pool->allocator;
+}
+
+/*
+ * Releases every chunk at once, invalidating all nodes of the pool,
+ * which stays usable. Containers using the pool must be freed or cleared
+ * first, or simply abandoned when all their memory came from the pool.
+ */
+cstd_inline void
+cstd_node_pool_free(cstd_node_pool_t* pool) {
+    cstd_node_pool_chunk_t* chunk = pool->chunks;
+    while (chunk) {
+        cstd_node_pool_chunk_t* next = chunk->next;
+        cstd_free(pool->parent, chunk, chunk->size);
+        chunk = next;
+    }
+    pool->free_list = NULL;
+    pool->chunks = NULL;
+    pool->cursor = NULL;
+    pool->end = NULL;
+}
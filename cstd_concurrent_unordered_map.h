@@ -0,0 +1,282 @@
+#pragma once
+
+#include "cstd_unordered_map.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <pthread.h>
+#endif
+
+/*
+ * pthread_rwlock_t is only declared with POSIX.1-2008 features enabled.
+ * In strict C mode, compile with -D_POSIX_C_SOURCE=200809L; the GNU
+ * dialects (-std=gnu11) enable it by default.
+ */
+#if !defined(_WIN32) && !defined(PTHREAD_RWLOCK_INITIALIZER)
+    #error "cstd_concurrent_unordered_map.h needs pthread_rwlock_t; \
+compile with -D_POSIX_C_SOURCE=200809L or -std=gnu11"
+#endif
+
+/* Default number of lock stripes, must be a power of two */
+#define CONCURRENT_UNORDERED_MAP_SHARD_COUNT 64
+
+#if defined(_WIN32)
+    typedef SRWLOCK cstd_rwlock_t;
+
+    cstd_inline void cstd_rwlock_init(cstd_rwlock_t* lock) {
+        InitializeSRWLock(lock);
+    }
+    cstd_inline void cstd_rwlock_destroy(cstd_rwlock_t* lock) {
+        cstd_unused(lock);
+    }
+    cstd_inline void cstd_rwlock_read_lock(cstd_rwlock_t* lock) {
+        AcquireSRWLockShared(lock);
+    }
+    cstd_inline void cstd_rwlock_read_unlock(cstd_rwlock_t* lock) {
+        ReleaseSRWLockShared(lock);
+    }
+    cstd_inline void cstd_rwlock_write_lock(cstd_rwlock_t* lock) {
+        AcquireSRWLockExclusive(lock);
+    }
+    cstd_inline void cstd_rwlock_write_unlock(cstd_rwlock_t* lock) {
+        ReleaseSRWLockExclusive(lock);
+    }
+#else
+    typedef pthread_rwlock_t cstd_rwlock_t;
+
+    cstd_inline void cstd_rwlock_init(cstd_rwlock_t* lock) {
+        pthread_rwlock_init(lock, NULL);
+    }
+    cstd_inline void cstd_rwlock_destroy(cstd_rwlock_t* lock) {
+        pthread_rwlock_destroy(lock);
+    }
+    cstd_inline void cstd_rwlock_read_lock(cstd_rwlock_t* lock) {
+        pthread_rwlock_rdlock(lock);
+    }
+    cstd_inline void cstd_rwlock_read_unlock(cstd_rwlock_t* lock) {
+        pthread_rwlock_unlock(lock);
+    }
+    cstd_inline void cstd_rwlock_write_lock(cstd_rwlock_t* lock) {
+        pthread_rwlock_wrlock(lock);
+    }
+    cstd_inline void cstd_rwlock_write_unlock(cstd_rwlock_t* lock) {
+        pthread_rwlock_unlock(lock);
+    }
+#endif
+
+/*
+ * One lock stripe: a reader-writer lock and the part of the table whose
+ * keys hash to it. Stripes are padded to whole cache lines.
+ */
+typedef struct cstd_align(CSTD_CACHE_LINE_SIZE) {
+    cstd_rwlock_t   lock;
+    unordered_map_t map;
+} concurrent_unordered_map_shard_t;
+
+/*
+ * Thread-safe unordered map. The key space is split over a fixed number
+ * of stripes chosen by the top bits of the mixed hash, and each stripe
+ * is a chained unordered_map_t guarded by its own reader-writer lock, so
+ * operations on different stripes never contend.
+ *
+ * Each stripe rehashes incrementally. Growing a stripe only allocates
+ * the new bucket array under its write lock, and later writers move a
+ * few buckets at a time, so readers are never held up by a full rehash.
+ * Lookups take the read lock and do not migrate buckets.
+ */
+typedef struct {
+    concurrent_unordered_map_shard_t* shards;
+    void*                             allocation;
+    size_t                            shard_count;
+    uint32_t                          shard_shift;
+    size_t                            key_size;
+    size_t                            value_size;
+    uint32_t (*hash_function)(const void *key);
+    bool     (*key_equals)(const void *key1, const void *key2);
+    const cstd_allocator_t*           allocator;
+} concurrent_unordered_map_t;
+
+/*
+ * Initialize a concurrent map with the given number of stripes, which is
+ * rounded up to a power of two, allocating from allocator, or with
+ * malloc when allocator is NULL. Stripes allocate under their own locks
+ * in parallel, so the allocator must be thread-safe. Returns false if
+ * allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_map_init_shards_with_allocator(
+    concurrent_unordered_map_t *map, const size_t key_size,
+    const size_t value_size, uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    size_t shard_count, const cstd_allocator_t *allocator) {
+    shard_count = cstd_next_pow2(shard_count);
+    uint32_t shard_bits = 0;
+    while (((size_t)1 << shard_bits) < shard_count) {
+        shard_bits++;
+    }
+
+    map->allocator = cstd_allocator_or_default(allocator);
+    map->allocation = cstd_alloc(
+        map->allocator,
+        shard_count * sizeof(concurrent_unordered_map_shard_t) +
+            CSTD_CACHE_LINE_SIZE);
+    if (!map->allocation) {
+        return false;
+    }
+    map->shards = (concurrent_unordered_map_shard_t*)cstd_align_up(
+        (size_t)map->allocation, CSTD_CACHE_LINE_SIZE);
+    map->shard_count = shard_count;
+    map->shard_shift = 32 - shard_bits;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->hash_function = hash_function;
+    map->key_equals = key_equals;
+
+    for (size_t i = 0; i < shard_count; i++) {
+        cstd_rwlock_init(&map->shards[i].lock);
+        cstd_unordered_map_init_incremental_with_allocator(
+            &map->shards[i].map, key_size, value_size, hash_function,
+            key_equals, allocator);
+    }
+    return true;
+}
+
+/*
+ * Initialize a concurrent map with the given number of stripes, which is
+ * rounded up to a power of two. Returns false if allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_map_init_shards(
+    concurrent_unordered_map_t *map, const size_t key_size,
+    const size_t value_size, uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    size_t shard_count) {
+    return cstd_concurrent_unordered_map_init_shards_with_allocator(
+        map, key_size, value_size, hash_function, key_equals, shard_count,
+        NULL);
+}
+
+/*
+ * Initialize a concurrent map with CONCURRENT_UNORDERED_MAP_SHARD_COUNT
+ * stripes. Returns false if allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_map_init(
+    concurrent_unordered_map_t *map, const size_t key_size,
+    const size_t value_size, uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2)) {
+    return cstd_concurrent_unordered_map_init_shards(
+        map, key_size, value_size, hash_function, key_equals,
+        CONCURRENT_UNORDERED_MAP_SHARD_COUNT);
+}
+
+/*
+ * Frees all stripes. No other thread may use the map during or after
+ * this call.
+ */
+cstd_inline void
+cstd_concurrent_unordered_map_free(concurrent_unordered_map_t *map) {
+    for (size_t i = 0; i < map->shard_count; i++) {
+        cstd_unordered_map_free(&map->shards[i].map);
+        cstd_rwlock_destroy(&map->shards[i].lock);
+    }
+    cstd_free(map->allocator, map->allocation,
+              map->shard_count * sizeof(concurrent_unordered_map_shard_t) +
+                  CSTD_CACHE_LINE_SIZE);
+    map->allocation = NULL;
+    map->shards = NULL;
+    map->shard_count = 0;
+}
+
+cstd_inline concurrent_unordered_map_shard_t*
+cstd_concurrent_unordered_map_shard(const concurrent_unordered_map_t *map,
+                                    const size_t hash) {
+    if (map->shard_count == 1) {
+        return map->shards;
+    }
+    return &map->shards[(uint32_t)hash >> map->shard_shift];
+}
+
+/*
+ * Copies the value stored for key into value_out and returns true, or
+ * returns false if the key is absent. value_out may be NULL to only test
+ * for membership. The value is copied under the stripe lock because a
+ * pointer into the map could be freed by another thread.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_map_find(concurrent_unordered_map_t *map,
+                                   const void *key,
+                                   void *value_out) {
+    size_t hash = cstd_hash_mix32(map->hash_function(key));
+    concurrent_unordered_map_shard_t* shard =
+        cstd_concurrent_unordered_map_shard(map, hash);
+
+    cstd_rwlock_read_lock(&shard->lock);
+    void* value = cstd_unordered_map_find_hashed(&shard->map, hash, key);
+    if (value && value_out) {
+        memcpy(value_out, value, map->value_size);
+    }
+    cstd_rwlock_read_unlock(&shard->lock);
+    return value != NULL;
+}
+
+/*
+ * Inserts or overwrites the value stored for key.
+ */
+cstd_inline void
+cstd_concurrent_unordered_map_insert(concurrent_unordered_map_t *map,
+                                     const void *key,
+                                     const void *value) {
+    size_t hash = cstd_hash_mix32(map->hash_function(key));
+    concurrent_unordered_map_shard_t* shard =
+        cstd_concurrent_unordered_map_shard(map, hash);
+
+    cstd_rwlock_write_lock(&shard->lock);
+    cstd_unordered_map_insert_hashed(&shard->map, hash, key, value);
+    cstd_rwlock_write_unlock(&shard->lock);
+}
+
+cstd_inline void
+cstd_concurrent_unordered_map_erase(concurrent_unordered_map_t *map,
+                                    const void *key) {
+    size_t hash = cstd_hash_mix32(map->hash_function(key));
+    concurrent_unordered_map_shard_t* shard =
+        cstd_concurrent_unordered_map_shard(map, hash);
+
+    cstd_rwlock_write_lock(&shard->lock);
+    cstd_unordered_map_erase_hashed(&shard->map, hash, key);
+    cstd_rwlock_write_unlock(&shard->lock);
+}
+
+/*
+ * Returns the number of entries. Stripes are counted one at a time, so
+ * the result is only a snapshot while other threads are writing.
+ */
+cstd_inline size_t
+cstd_concurrent_unordered_map_size(concurrent_unordered_map_t *map) {
+    size_t size = 0;
+    for (size_t i = 0; i < map->shard_count; i++) {
+        cstd_rwlock_read_lock(&map->shards[i].lock);
+        size += map->shards[i].map.size;
+        cstd_rwlock_read_unlock(&map->shards[i].lock);
+    }
+    return size;
+}
+
+cstd_inline bool
+cstd_concurrent_unordered_map_empty(concurrent_unordered_map_t *map) {
+    return cstd_concurrent_unordered_map_size(map) == 0;
+}
+
+/*
+ * Removes every entry, one stripe at a time.
+ */
+cstd_inline void
+cstd_concurrent_unordered_map_clear(concurrent_unordered_map_t *map) {
+    for (size_t i = 0; i < map->shard_count; i++) {
+        cstd_rwlock_write_lock(&map->shards[i].lock);
+        cstd_unordered_map_clear(&map->shards[i].map);
+        cstd_rwlock_write_unlock(&map->shards[i].lock);
+    }
+}
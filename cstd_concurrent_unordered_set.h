@@ -0,0 +1,496 @@
+#pragma once
+
+#include <stdatomic.h>
+
+#include "cstd_unordered_set.h"
+
+/* Default number of reader slots */
+#define CONCURRENT_UNORDERED_SET_MAX_READERS 64
+
+/* Number of retired objects the writer collects before reclaiming */
+#define CONCURRENT_UNORDERED_SET_RECLAIM_THRESHOLD 64
+
+/*
+ * A node of the concurrent set. The key bytes follow the header in the
+ * same allocation, and next is atomic so readers can follow chains while
+ * the writer relinks them.
+ */
+typedef struct concurrent_hash_node {
+    _Atomic(struct concurrent_hash_node*) next;
+    size_t                                hash;
+    unsigned char                         key[];
+} concurrent_hash_node_t;
+
+typedef struct {
+    size_t                           bucket_count;
+    _Atomic(concurrent_hash_node_t*) buckets[];
+} concurrent_unordered_set_table_t;
+
+/*
+ * A reader slot. A reader publishes the global epoch it entered in, or
+ * zero while it is outside a lookup. Each slot fills a whole cache line,
+ * so a reader only ever writes a line that no other reader touches.
+ */
+typedef struct cstd_align(CSTD_CACHE_LINE_SIZE) {
+    _Atomic uint64_t epoch;
+    atomic_bool      in_use;
+} concurrent_unordered_set_reader_t;
+
+/* An object unlinked by the writer, waiting for readers to move on */
+typedef struct {
+    void*    pointer;
+    uint64_t epoch;
+    bool     is_table;
+} concurrent_unordered_set_retired_t;
+
+/*
+ * Unordered set with wait-free lookups for many readers and a single
+ * writer. Readers never take a lock: they announce the current epoch in
+ * their own reader slot, walk the atomic bucket chains and clear the
+ * slot again. The writer inserts and erases without blocking readers,
+ * and frees unlinked nodes only once every reader that might still see
+ * them has left its lookup (epoch-based reclamation). Growing the table
+ * copies the nodes into a new table, which is published atomically.
+ *
+ * Only one thread may call the writer functions (insert, erase, clear,
+ * reclaim) at a time. All allocation and freeing happens in the writer,
+ * so a custom allocator does not need to be thread-safe as long as
+ * nothing else uses it concurrently.
+ */
+typedef struct {
+    _Atomic(concurrent_unordered_set_table_t*) table;
+    _Atomic uint64_t                           epoch;
+    _Atomic size_t                             size;
+    size_t                                     key_size;
+    hash_func_t                                hash;
+    compare_func_t                             compare;
+    concurrent_unordered_set_reader_t*         readers;
+    void*                                      reader_allocation;
+    size_t                                     reader_count;
+    concurrent_unordered_set_retired_t*        retired;
+    size_t                                     retired_size;
+    size_t                                     retired_capacity;
+    const cstd_allocator_t*                    allocator;
+} concurrent_unordered_set_t;
+
+cstd_inline size_t
+cstd_concurrent_unordered_set_table_size(size_t bucket_count) {
+    return sizeof(concurrent_unordered_set_table_t) +
+           bucket_count * sizeof(_Atomic(concurrent_hash_node_t*));
+}
+
+cstd_inline size_t
+cstd_concurrent_unordered_set_node_size(const concurrent_unordered_set_t* set) {
+    return sizeof(concurrent_hash_node_t) + set->key_size;
+}
+
+cstd_inline concurrent_unordered_set_table_t*
+cstd_concurrent_unordered_set_new_table(const concurrent_unordered_set_t* set,
+                                        size_t bucket_count) {
+    concurrent_unordered_set_table_t* table =
+        (concurrent_unordered_set_table_t*)cstd_alloc(
+            set->allocator,
+            cstd_concurrent_unordered_set_table_size(bucket_count));
+    if (!table) {
+        return NULL;
+    }
+    table->bucket_count = bucket_count;
+    for (size_t i = 0; i < bucket_count; i++) {
+        atomic_init(&table->buckets[i], NULL);
+    }
+    return table;
+}
+
+/* Frees a table together with every node still linked into it */
+cstd_inline void
+cstd_concurrent_unordered_set_free_table(
+    const concurrent_unordered_set_t* set,
+    concurrent_unordered_set_table_t* table) {
+    for (size_t i = 0; i < table->bucket_count; i++) {
+        concurrent_hash_node_t* node = atomic_load_explicit(
+            &table->buckets[i], memory_order_relaxed);
+        while (node) {
+            concurrent_hash_node_t* next =
+                atomic_load_explicit(&node->next, memory_order_relaxed);
+            cstd_free(set->allocator, node,
+                      cstd_concurrent_unordered_set_node_size(set));
+            node = next;
+        }
+    }
+    cstd_free(set->allocator, table,
+              cstd_concurrent_unordered_set_table_size(table->bucket_count));
+}
+
+/* Frees one entry of the reclamation list */
+cstd_inline void
+cstd_concurrent_unordered_set_free_retired(
+    const concurrent_unordered_set_t* set,
+    const concurrent_unordered_set_retired_t* item) {
+    if (item->is_table) {
+        cstd_concurrent_unordered_set_free_table(
+            set, (concurrent_unordered_set_table_t*)item->pointer);
+    } else {
+        cstd_free(set->allocator, item->pointer,
+                  cstd_concurrent_unordered_set_node_size(set));
+    }
+}
+
+/*
+ * Initialize a concurrent set with room for max_readers registered
+ * reader threads, allocating from allocator, or with malloc when
+ * allocator is NULL. Returns false if allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_init_readers_with_allocator(
+    concurrent_unordered_set_t* set, size_t key_size, hash_func_t hash,
+    compare_func_t compare, size_t max_readers,
+    const cstd_allocator_t* allocator) {
+    set->allocator = cstd_allocator_or_default(allocator);
+    set->key_size = key_size;
+    concurrent_unordered_set_table_t* table =
+        cstd_concurrent_unordered_set_new_table(
+            set, CSTD_UNORDERED_SET_INIT_BUCKET_COUNT);
+    size_t reader_bytes =
+        max_readers * sizeof(concurrent_unordered_set_reader_t) +
+        CSTD_CACHE_LINE_SIZE;
+    set->reader_allocation = cstd_alloc(set->allocator, reader_bytes);
+    if (!table || !set->reader_allocation) {
+        if (table) {
+            cstd_concurrent_unordered_set_free_table(set, table);
+        }
+        cstd_free(set->allocator, set->reader_allocation, reader_bytes);
+        return false;
+    }
+    set->readers = (concurrent_unordered_set_reader_t*)cstd_align_up(
+        (size_t)set->reader_allocation, CSTD_CACHE_LINE_SIZE);
+    set->reader_count = max_readers;
+    for (size_t i = 0; i < max_readers; i++) {
+        atomic_init(&set->readers[i].epoch, 0);
+        atomic_init(&set->readers[i].in_use, false);
+    }
+
+    atomic_init(&set->table, table);
+    atomic_init(&set->epoch, 1);
+    atomic_init(&set->size, 0);
+    set->hash = hash;
+    set->compare = compare;
+    set->retired = NULL;
+    set->retired_size = 0;
+    set->retired_capacity = 0;
+    return true;
+}
+
+/*
+ * Initialize a concurrent set with room for max_readers registered
+ * reader threads. Returns false if allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_init_readers(concurrent_unordered_set_t* set,
+                                           size_t key_size, hash_func_t hash,
+                                           compare_func_t compare,
+                                           size_t max_readers) {
+    return cstd_concurrent_unordered_set_init_readers_with_allocator(
+        set, key_size, hash, compare, max_readers, NULL);
+}
+
+/*
+ * Initialize a concurrent set with CONCURRENT_UNORDERED_SET_MAX_READERS
+ * reader slots. Returns false if allocation fails.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_init(concurrent_unordered_set_t* set,
+                                   size_t key_size, hash_func_t hash,
+                                   compare_func_t compare) {
+    return cstd_concurrent_unordered_set_init_readers(
+        set, key_size, hash, compare, CONCURRENT_UNORDERED_SET_MAX_READERS);
+}
+
+/*
+ * Claims a reader slot for the calling thread. Returns NULL when every
+ * slot is taken. A slot must only be used by one thread at a time.
+ */
+cstd_inline concurrent_unordered_set_reader_t*
+cstd_concurrent_unordered_set_register_reader(concurrent_unordered_set_t* set) {
+    for (size_t i = 0; i < set->reader_count; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&set->readers[i].in_use,
+                                           &expected, true)) {
+            return &set->readers[i];
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Releases a reader slot claimed with
+ * cstd_concurrent_unordered_set_register_reader.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_unregister_reader(
+    concurrent_unordered_set_reader_t* reader) {
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+    atomic_store_explicit(&reader->in_use, false, memory_order_release);
+}
+
+cstd_inline concurrent_hash_node_t*
+cstd_concurrent_unordered_set_chain_find(
+    const concurrent_unordered_set_t* set,
+    const concurrent_unordered_set_table_t* table,
+    size_t hash, const void* key) {
+    concurrent_hash_node_t* node =
+        atomic_load(&table->buckets[hash & (table->bucket_count - 1)]);
+    while (node) {
+        if (node->hash == hash && set->compare(node->key, key) == 0) {
+            return node;
+        }
+        node = atomic_load(&node->next);
+    }
+    return NULL;
+}
+
+/*
+ * Returns true if the key is in the set. Safe to call from any number of
+ * threads concurrently with the writer; the reader slot must belong to
+ * the calling thread. The lookup takes no lock and only writes the
+ * reader's own slot.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_find(const concurrent_unordered_set_t* set,
+                                   concurrent_unordered_set_reader_t* reader,
+                                   const void* key) {
+    size_t hash = cstd_hash_mix_size(set->hash(key));
+
+    /*
+     * Announce the epoch before touching any node of the table. The slot
+     * store, the table and chain loads here and the writer's unlinking
+     * stores and slot scan are all sequentially consistent, so either
+     * the writer sees this slot or this lookup sees the unlinked state.
+     */
+    atomic_store(&reader->epoch, atomic_load(&set->epoch));
+    concurrent_unordered_set_table_t* table = atomic_load(&set->table);
+    bool found =
+        cstd_concurrent_unordered_set_chain_find(set, table, hash, key) != NULL;
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+    return found;
+}
+
+/*
+ * Frees every retired object that no reader can still reference. Called
+ * by the writer; also runs automatically once enough objects are
+ * retired.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_reclaim(concurrent_unordered_set_t* set) {
+    uint64_t oldest = atomic_fetch_add(&set->epoch, 1) + 1;
+    for (size_t i = 0; i < set->reader_count; i++) {
+        uint64_t epoch = atomic_load(&set->readers[i].epoch);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < set->retired_size; i++) {
+        concurrent_unordered_set_retired_t* item = &set->retired[i];
+        if (item->epoch < oldest) {
+            cstd_concurrent_unordered_set_free_retired(set, item);
+        } else {
+            set->retired[kept++] = *item;
+        }
+    }
+    set->retired_size = kept;
+}
+
+/*
+ * Hands an unlinked node or table to the reclamation list, tagged with
+ * the current epoch.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_retire(concurrent_unordered_set_t* set,
+                                     void* pointer, bool is_table) {
+    if (set->retired_size == set->retired_capacity) {
+        size_t new_capacity =
+            set->retired_capacity ? set->retired_capacity * 2
+                                  : CONCURRENT_UNORDERED_SET_RECLAIM_THRESHOLD;
+        concurrent_unordered_set_retired_t* retired =
+            (concurrent_unordered_set_retired_t*)cstd_realloc(
+                set->allocator, set->retired,
+                set->retired_capacity *
+                    sizeof(concurrent_unordered_set_retired_t),
+                new_capacity * sizeof(concurrent_unordered_set_retired_t));
+        if (!retired) {
+            // Nothing can be freed safely; leak rather than corrupt readers
+            return;
+        }
+        set->retired = retired;
+        set->retired_capacity = new_capacity;
+    }
+    concurrent_unordered_set_retired_t* item =
+        &set->retired[set->retired_size++];
+    item->pointer = pointer;
+    item->epoch = atomic_load(&set->epoch);
+    item->is_table = is_table;
+
+    if (set->retired_size >= CONCURRENT_UNORDERED_SET_RECLAIM_THRESHOLD) {
+        cstd_concurrent_unordered_set_reclaim(set);
+    }
+}
+
+/*
+ * Publishes a copy of the table with the given bucket count. Readers
+ * still walking the old table keep seeing its nodes until it is
+ * reclaimed.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_resize(concurrent_unordered_set_t* set,
+                                     size_t new_bucket_count) {
+    new_bucket_count = cstd_next_pow2(new_bucket_count);
+    concurrent_unordered_set_table_t* old_table =
+        atomic_load_explicit(&set->table, memory_order_relaxed);
+    concurrent_unordered_set_table_t* new_table =
+        cstd_concurrent_unordered_set_new_table(set, new_bucket_count);
+    if (!new_table) {
+        return;
+    }
+
+    for (size_t i = 0; i < old_table->bucket_count; i++) {
+        concurrent_hash_node_t* node = atomic_load_explicit(
+            &old_table->buckets[i], memory_order_relaxed);
+        while (node) {
+            concurrent_hash_node_t* copy = (concurrent_hash_node_t*)cstd_alloc(
+                set->allocator, cstd_concurrent_unordered_set_node_size(set));
+            if (!copy) {
+                cstd_concurrent_unordered_set_free_table(set, new_table);
+                return;
+            }
+            size_t index = node->hash & (new_bucket_count - 1);
+            memcpy(copy->key, node->key, set->key_size);
+            copy->hash = node->hash;
+            atomic_init(&copy->next, atomic_load_explicit(
+                &new_table->buckets[index], memory_order_relaxed));
+            atomic_init(&new_table->buckets[index], copy);
+            node = atomic_load_explicit(&node->next, memory_order_relaxed);
+        }
+    }
+
+    atomic_store(&set->table, new_table);
+    cstd_concurrent_unordered_set_retire(set, old_table, true);
+}
+
+/*
+ * Inserts a key. Returns true if the key was inserted, false if it
+ * already exists. Writer only.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_insert(concurrent_unordered_set_t* set,
+                                     const void* key) {
+    concurrent_unordered_set_table_t* table =
+        atomic_load_explicit(&set->table, memory_order_relaxed);
+    size_t size = atomic_load_explicit(&set->size, memory_order_relaxed);
+    if (size + 1 > table->bucket_count * CSTD_UNORDERED_SET_MAX_LOAD_FACTOR) {
+        cstd_concurrent_unordered_set_resize(set, table->bucket_count * 2);
+        table = atomic_load_explicit(&set->table, memory_order_relaxed);
+    }
+
+    size_t hash = cstd_hash_mix_size(set->hash(key));
+    if (cstd_concurrent_unordered_set_chain_find(set, table, hash, key)) {
+        return false;
+    }
+
+    concurrent_hash_node_t* node = (concurrent_hash_node_t*)cstd_alloc(
+        set->allocator, cstd_concurrent_unordered_set_node_size(set));
+    if (!node) {
+        return false;
+    }
+    _Atomic(concurrent_hash_node_t*)* bucket =
+        &table->buckets[hash & (table->bucket_count - 1)];
+    memcpy(node->key, key, set->key_size);
+    node->hash = hash;
+    atomic_init(&node->next,
+                atomic_load_explicit(bucket, memory_order_relaxed));
+    atomic_store(bucket, node);
+    atomic_store_explicit(&set->size, size + 1, memory_order_relaxed);
+    return true;
+}
+
+/*
+ * Removes a key. Returns true if it was found. The node is freed once
+ * no reader can still be looking at it. Writer only.
+ */
+cstd_inline bool
+cstd_concurrent_unordered_set_erase(concurrent_unordered_set_t* set,
+                                    const void* key) {
+    concurrent_unordered_set_table_t* table =
+        atomic_load_explicit(&set->table, memory_order_relaxed);
+    size_t hash = cstd_hash_mix_size(set->hash(key));
+    _Atomic(concurrent_hash_node_t*)* link =
+        &table->buckets[hash & (table->bucket_count - 1)];
+    concurrent_hash_node_t* node =
+        atomic_load_explicit(link, memory_order_relaxed);
+
+    while (node) {
+        if (node->hash == hash && set->compare(node->key, key) == 0) {
+            atomic_store(link, atomic_load_explicit(&node->next,
+                                                    memory_order_relaxed));
+            atomic_fetch_sub_explicit(&set->size, 1, memory_order_relaxed);
+            cstd_concurrent_unordered_set_retire(set, node, false);
+            return true;
+        }
+        link = &node->next;
+        node = atomic_load_explicit(link, memory_order_relaxed);
+    }
+    return false;
+}
+
+/*
+ * Removes every key by publishing an empty table. Writer only.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_clear(concurrent_unordered_set_t* set) {
+    concurrent_unordered_set_table_t* table =
+        cstd_concurrent_unordered_set_new_table(
+            set, CSTD_UNORDERED_SET_INIT_BUCKET_COUNT);
+    if (!table) {
+        return;
+    }
+    concurrent_unordered_set_table_t* old_table =
+        atomic_exchange(&set->table, table);
+    atomic_store_explicit(&set->size, 0, memory_order_relaxed);
+    cstd_concurrent_unordered_set_retire(set, old_table, true);
+}
+
+/*
+ * Frees the set and everything still waiting for reclamation. No reader
+ * may be inside a lookup.
+ */
+cstd_inline void
+cstd_concurrent_unordered_set_free(concurrent_unordered_set_t* set) {
+    for (size_t i = 0; i < set->retired_size; i++) {
+        cstd_concurrent_unordered_set_free_retired(set, &set->retired[i]);
+    }
+    cstd_free(set->allocator, set->retired,
+              set->retired_capacity *
+                  sizeof(concurrent_unordered_set_retired_t));
+    cstd_concurrent_unordered_set_free_table(
+        set, atomic_load_explicit(&set->table, memory_order_relaxed));
+    cstd_free(set->allocator, set->reader_allocation,
+              set->reader_count * sizeof(concurrent_unordered_set_reader_t) +
+                  CSTD_CACHE_LINE_SIZE);
+    set->retired = NULL;
+    set->retired_size = 0;
+    set->retired_capacity = 0;
+}
+
+/*
+ * Returns the number of keys. Readers see a recent, not necessarily
+ * current, value.
+ */
+cstd_inline size_t
+cstd_concurrent_unordered_set_size(const concurrent_unordered_set_t* set) {
+    return atomic_load_explicit(&set->size, memory_order_relaxed);
+}
+
+cstd_inline bool
+cstd_concurrent_unordered_set_empty(const concurrent_unordered_set_t* set) {
+    return cstd_concurrent_unordered_set_size(set) == 0;
+}
@@ -21,20 +21,24 @@ typedef struct {
     size_t capacity;
     /* The size of each element in the deque */
     size_t element_size;
+    /* Where the data buffer is allocated from */
+    const cstd_allocator_t* allocator;
 } deque_t;
 
 /*
- * Allocate memory for the deque's data and initialize the head and
- * tail indices to 0. The size is 0 and the capacity is set to the
- * initial capacity. The element size is set to the given element
- * size.
+ * Allocate memory for the deque's data from allocator (NULL for malloc)
+ * and initialize the head and tail indices to 0. The size is 0 and the
+ * capacity is set to the initial capacity. The element size is set to
+ * the given element size.
  */
 cstd_inline void 
-cstd_deque_init(deque_t* dq, const size_t element_size) {
+cstd_deque_init_with_allocator(deque_t* dq, const size_t element_size,
+                               const cstd_allocator_t* allocator) {
     if (dq == NULL) {
         return;
     }
-    dq->data = malloc(DEQUE_INIT_CAPACITY * element_size);
+    dq->allocator = cstd_allocator_or_default(allocator);
+    dq->data = cstd_alloc(dq->allocator, DEQUE_INIT_CAPACITY * element_size);
     if (dq->data == NULL) {
         return;
     }
@@ -45,6 +49,14 @@ cstd_deque_init(deque_t* dq, const size_t element_size) {
     dq->element_size = element_size;
 }
 
+/*
+ * Initialize a deque whose buffer is allocated with malloc.
+ */
+cstd_inline void 
+cstd_deque_init(deque_t* dq, const size_t element_size) {
+    cstd_deque_init_with_allocator(dq, element_size, NULL);
+}
+
 /*
  * Resizes the deque's backing array to the specified capacity. This
  * function should only be called by the cstd_deque_push_back and
@@ -53,7 +65,8 @@ cstd_deque_init(deque_t* dq, const size_t element_size) {
 cstd_inline void 
 cstd_deque_resize(deque_t* dq, const size_t new_capacity) {
     if (dq->data) {
-        void* new_data = malloc(new_capacity * dq->element_size);
+        void* new_data = cstd_alloc(dq->allocator,
+                                    new_capacity * dq->element_size);
         if (new_data) {
             for (size_t i = 0; i < dq->size; i++) {
                 memmove((char*)new_data + i * dq->element_size,
@@ -62,7 +75,8 @@ cstd_deque_resize(deque_t* dq, const size_t new_capacity) {
                                                dq->element_size,
                         dq->element_size);
             }
-            free(dq->data);
+            cstd_free(dq->allocator, dq->data,
+                      dq->capacity * dq->element_size);
             dq->data = new_data;
             dq->head = 0;
             dq->tail = dq->size;
@@ -74,7 +88,7 @@ cstd_deque_resize(deque_t* dq, const size_t new_capacity) {
 cstd_inline void 
 cstd_deque_free(deque_t* dq) { 
     if (dq->data) { 
-        free(dq->data); 
+        cstd_free(dq->allocator, dq->data, dq->capacity * dq->element_size);
     } 
 }
 
@@ -11,14 +11,63 @@ typedef struct forward_list_node {
  * This is a forward list implementation. The implementation uses a
  * forward_list_node_t struct as the list node, which contains a pointer
  * to the next node in the list, and a void* pointer to the data. The
- * forward_list_t struct contains the head of the list, and the size of
- * the data in the list. 
+ * data is stored right behind the node in the same allocation. The
+ * forward_list_t struct contains the head of the list, the number of
+ * elements and the size of the data in the list. 
+ *
+ * A list set up with cstd_forward_list_init_tailed also keeps a pointer
+ * to its last node, which allows O(1) push_back and splicing; in other
+ * lists tail is always NULL.
  */
 typedef struct {
-    forward_list_node_t* head;
-    size_t               element_size;
+    forward_list_node_t*    head;
+    forward_list_node_t*    tail;
+    size_t                  size;
+    size_t                  element_size;
+    bool                    tailed;
+    const cstd_allocator_t* allocator;
 } forward_list_t;
 
+/* 
+ * Initializes a forward list whose nodes are allocated from allocator,
+ * or with malloc when allocator is NULL.
+ */
+cstd_inline void 
+cstd_forward_list_init_with_allocator(forward_list_t* list,
+                                      const size_t element_size,
+                                      const cstd_allocator_t* allocator) {
+    list->head = NULL;
+    list->tail = NULL;
+    list->size = 0;
+    list->element_size = element_size;
+    list->tailed = false;
+    list->allocator = cstd_allocator_or_default(allocator);
+}
+
+/*
+ * Initializes a forward list that tracks its last node, allocating from
+ * allocator, or with malloc when allocator is NULL.
+ */
+cstd_inline void 
+cstd_forward_list_init_tailed_with_allocator(
+    forward_list_t* list, const size_t element_size,
+    const cstd_allocator_t* allocator) {
+    cstd_forward_list_init_with_allocator(list, element_size, allocator);
+    list->tailed = true;
+}
+
+/*
+ * Initializes a forward list that tracks its last node, so that
+ * cstd_forward_list_push_back and cstd_forward_list_splice_back run in
+ * O(1). Keeping the tail costs one comparison in insert_after and
+ * erase_after.
+ */
+cstd_inline void 
+cstd_forward_list_init_tailed(forward_list_t* list,
+                              const size_t element_size) {
+    cstd_forward_list_init_tailed_with_allocator(list, element_size, NULL);
+}
+
 /* 
  * This function initializes a forward list. It takes a pointer to the 
  * forward list and the size of the elements to be inserted in the 
@@ -27,8 +76,29 @@ typedef struct {
 cstd_inline void 
 cstd_forward_list_init(forward_list_t* list,
                        const size_t element_size) {
-    list->head = NULL;
-    list->element_size = element_size;
+    cstd_forward_list_init_with_allocator(list, element_size, NULL);
+}
+
+/*
+ * Returns the number of bytes allocated for one node. The element is
+ * stored right behind the header, so a node is a single allocation and
+ * data points into it. This is the node size to create a
+ * cstd_node_pool_t with for a forward list.
+ */
+cstd_inline size_t 
+cstd_forward_list_node_size(const size_t element_size) {
+    return cstd_align_up(sizeof(forward_list_node_t),
+                         cstd_size_alignment(element_size)) + element_size;
+}
+
+/*
+ * Frees a node together with the data stored in it.
+ */
+cstd_inline void 
+cstd_forward_list_free_node(forward_list_t* list,
+                            forward_list_node_t* node) {
+    cstd_free(list->allocator, node,
+              cstd_forward_list_node_size(list->element_size));
 }
 
 /* 
@@ -36,8 +106,7 @@ cstd_forward_list_init(forward_list_t* list,
  * as the data in each node. It does not free the list itself. 
  * 
  * For each node in the list, it will: 
- *  - Free the data in the node 
- *  - Free the node itself 
+ *  - Free the node, together with its data 
  *  - Move to the next node 
  * 
  * Once the loop is complete, it will set the list's head to NULL. 
@@ -49,11 +118,12 @@ cstd_forward_list_free(forward_list_t* list) {
     forward_list_node_t* next;
     while (current != NULL) {
         next = current->next;
-        free(current->data);
-        free(current);
+        cstd_forward_list_free_node(list, current);
         current = next;
     }
     list->head = NULL;
+    list->tail = NULL;
+    list->size = 0;
 }
 
 /*
@@ -64,11 +134,12 @@ cstd_forward_list_free(forward_list_t* list) {
  */
 cstd_inline forward_list_node_t* 
 cstd_forward_list_create_node(
-    const void* data, const size_t element_size) {
+    forward_list_t* list, const void* data) {
+    size_t node_size = cstd_forward_list_node_size(list->element_size);
     forward_list_node_t* new_node =
-        (forward_list_node_t*)malloc(sizeof(forward_list_node_t));
-    new_node->data = malloc(element_size);
-    memcpy(new_node->data, data, element_size);
+        (forward_list_node_t*)cstd_alloc(list->allocator, node_size);
+    new_node->data = (unsigned char*)new_node + node_size - list->element_size;
+    memcpy(new_node->data, data, list->element_size);
     new_node->next = NULL;
     return new_node;
 }
@@ -82,9 +153,32 @@ cstd_inline void
 cstd_forward_list_push_front(forward_list_t* list,
                              void* element) {
     forward_list_node_t* new_node =
-        cstd_forward_list_create_node(element, list->element_size);
+        cstd_forward_list_create_node(list, element);
     new_node->next = list->head;
     list->head = new_node;
+    if (list->tailed && new_node->next == NULL) {
+        list->tail = new_node;
+    }
+    list->size++;
+}
+
+/*
+ * Appends an element to the end of a list set up with
+ * cstd_forward_list_init_tailed.
+ */
+cstd_inline void 
+cstd_forward_list_push_back(forward_list_t* list,
+                            void* element) {
+    assert(list->tailed);
+    forward_list_node_t* new_node =
+        cstd_forward_list_create_node(list, element);
+    if (list->tail != NULL) {
+        list->tail->next = new_node;
+    } else {
+        list->head = new_node;
+    }
+    list->tail = new_node;
+    list->size++;
 }
 
 /* 
@@ -95,8 +189,11 @@ cstd_forward_list_pop_front(forward_list_t* list) {
     if (list->head != NULL) {
         forward_list_node_t* old_head = list->head;
         list->head = old_head->next;
-        free(old_head->data);
-        free(old_head);
+        if (list->head == NULL) {
+            list->tail = NULL;
+        }
+        cstd_forward_list_free_node(list, old_head);
+        list->size--;
     }
 }
 
@@ -108,10 +205,18 @@ cstd_forward_list_pop_front(forward_list_t* list) {
 cstd_inline forward_list_node_t* 
 cstd_forward_list_insert_after(
     forward_list_t* list, forward_list_node_t* node, void* element) {
+    if (node == NULL) {
+        cstd_forward_list_push_front(list, element);
+        return list->head;
+    }
     forward_list_node_t* new_node =
-        cstd_forward_list_create_node(element, list->element_size);
+        cstd_forward_list_create_node(list, element);
     new_node->next = node->next;
     node->next = new_node;
+    if (node == list->tail) {
+        list->tail = new_node;
+    }
+    list->size++;
     return new_node;
 }
 
@@ -126,9 +231,37 @@ cstd_forward_list_erase_after(forward_list_t* list,
     forward_list_node_t* to_erase = node->next;
     if (to_erase != NULL) {
         node->next = to_erase->next;
-        free(to_erase->data);
-        free(to_erase);
+        if (to_erase == list->tail) {
+            list->tail = node;
+        }
+        cstd_forward_list_free_node(list, to_erase);
+        list->size--;
+    }
+}
+
+/*
+ * Moves every node of other to the end of list in O(1), leaving other
+ * empty. Both lists must be set up with cstd_forward_list_init_tailed
+ * and share the element size and allocator.
+ */
+cstd_inline void 
+cstd_forward_list_splice_back(forward_list_t* list,
+                              forward_list_t* other) {
+    assert(list->tailed && other->tailed);
+    assert(list->element_size == other->element_size);
+    if (other->head == NULL) {
+        return;
     }
+    if (list->tail != NULL) {
+        list->tail->next = other->head;
+    } else {
+        list->head = other->head;
+    }
+    list->tail = other->tail;
+    list->size += other->size;
+    other->head = NULL;
+    other->tail = NULL;
+    other->size = 0;
 }
 
 /*
@@ -170,13 +303,17 @@ cstd_forward_list_clear(forward_list_t* list) {
  */ 
 cstd_inline size_t 
 cstd_forward_list_size(forward_list_t* list) {
-    size_t size = 0;
-    forward_list_node_t* current = list->head;
-    while (current != NULL) {
-        size++;
-        current = current->next;
-    }
-    return size;
+    return list->size;
+}
+
+/*
+ * Returns the data of the last element of a list set up with
+ * cstd_forward_list_init_tailed, or NULL if the list is empty.
+ */
+cstd_inline void* 
+cstd_forward_list_back(forward_list_t* list) {
+    assert(list->tailed);
+    return list->tail != NULL ? list->tail->data : NULL;
 }
 
 /* 
@@ -8,38 +8,309 @@ typedef struct list_node {
     struct list_node* next;
 } list_node_t;
 
+/* Default payload bytes of one block of an unrolled list */
+#define CSTD_LIST_UNROLLED_BLOCK_BYTES 256
+
+/*
+ * Block of an unrolled list. count elements are stored contiguously
+ * right behind the header.
+ */
+typedef struct list_block {
+    struct list_block* prev;
+    struct list_block* next;
+    size_t count;
+} list_block_t;
+
+/*
+ * Doubly linked list. By default every element has its own list_node_t.
+ * A list set up with cstd_list_init_unrolled instead keeps up to
+ * block_capacity elements per list_block_t, so walking to a position
+ * hops once per block rather than once per element. head and tail are
+ * unused in that mode; the index-based functions accept either layout.
+ */
 typedef struct {
     list_node_t* head;
     list_node_t* tail;
     size_t size;
     size_t element_size;
+    const cstd_allocator_t* allocator;
+    /* Unrolled layout, only used when block_capacity is not zero */
+    list_block_t* first_block;
+    list_block_t* last_block;
+    size_t block_capacity;
 } list_t;
 
+/*
+ * Initialize a list whose nodes are allocated from allocator (NULL for
+ * malloc).
+ */
 cstd_inline void 
-cstd_list_init(list_t* lst, const size_t element_size) {
+cstd_list_init_with_allocator(list_t* lst, const size_t element_size,
+                              const cstd_allocator_t* allocator) {
     lst->head = NULL;
     lst->tail = NULL;
     lst->size = 0;
     lst->element_size = element_size;
+    lst->allocator = cstd_allocator_or_default(allocator);
+    lst->first_block = NULL;
+    lst->last_block = NULL;
+    lst->block_capacity = 0;
+}
+
+cstd_inline void 
+cstd_list_init(list_t* lst, const size_t element_size) {
+    cstd_list_init_with_allocator(lst, element_size, NULL);
+}
+
+/*
+ * Initialize an unrolled list whose blocks hold block_bytes of elements
+ * (CSTD_LIST_UNROLLED_BLOCK_BYTES when 0), but at least two, allocated
+ * from allocator (NULL for malloc).
+ */
+cstd_inline void 
+cstd_list_init_unrolled_with_allocator(list_t* lst, const size_t element_size,
+                                       size_t block_bytes,
+                                       const cstd_allocator_t* allocator) {
+    cstd_list_init_with_allocator(lst, element_size, allocator);
+    if (block_bytes == 0) {
+        block_bytes = CSTD_LIST_UNROLLED_BLOCK_BYTES;
+    }
+    lst->block_capacity = element_size ? block_bytes / element_size : 2;
+    if (lst->block_capacity < 2) {
+        lst->block_capacity = 2;
+    }
+}
+
+/*
+ * Initialize an unrolled list. Elements are packed into blocks of about
+ * block_bytes, so iterating and positional access touch far fewer nodes,
+ * while inserting or erasing in the middle only shifts the elements of
+ * one block. Pointers to elements are invalidated by any insertion or
+ * erasure.
+ */
+cstd_inline void 
+cstd_list_init_unrolled(list_t* lst, const size_t element_size,
+                        size_t block_bytes) {
+    cstd_list_init_unrolled_with_allocator(lst, element_size, block_bytes,
+                                           NULL);
+}
+
+cstd_inline size_t 
+cstd_list_block_data_offset(const list_t* lst) {
+    return cstd_align_up(sizeof(list_block_t),
+                         cstd_size_alignment(lst->element_size));
+}
+
+cstd_inline size_t 
+cstd_list_block_size(const list_t* lst) {
+    return cstd_list_block_data_offset(lst) +
+           lst->block_capacity * lst->element_size;
+}
+
+/*
+ * Returns a pointer to the element at position index within a block.
+ */
+cstd_inline unsigned char* 
+cstd_list_block_element(const list_t* lst, const list_block_t* block,
+                        size_t index) {
+    return (unsigned char*)block + cstd_list_block_data_offset(lst) +
+           index * lst->element_size;
+}
+
+/*
+ * Allocates an empty block and links it between prev and next.
+ */
+cstd_inline list_block_t* 
+cstd_list_new_block(list_t* lst, list_block_t* prev, list_block_t* next) {
+    list_block_t* block = (list_block_t*)cstd_alloc(lst->allocator,
+                                                    cstd_list_block_size(lst));
+    block->count = 0;
+    block->prev = prev;
+    block->next = next;
+    if (prev) {
+        prev->next = block;
+    } else {
+        lst->first_block = block;
+    }
+    if (next) {
+        next->prev = block;
+    } else {
+        lst->last_block = block;
+    }
+    return block;
+}
+
+cstd_inline void 
+cstd_list_free_block(list_t* lst, list_block_t* block) {
+    if (block->prev) {
+        block->prev->next = block->next;
+    } else {
+        lst->first_block = block->next;
+    }
+    if (block->next) {
+        block->next->prev = block->prev;
+    } else {
+        lst->last_block = block->prev;
+    }
+    cstd_free(lst->allocator, block, cstd_list_block_size(lst));
+}
+
+/*
+ * Finds the block holding the element at index, walking from whichever
+ * end is closer, and stores the position within the block in offset.
+ */
+cstd_inline list_block_t* 
+cstd_list_find_block(const list_t* lst, size_t index, size_t* offset) {
+    list_block_t* block;
+    if (index < lst->size / 2) {
+        block = lst->first_block;
+        while (index >= block->count) {
+            index -= block->count;
+            block = block->next;
+        }
+        *offset = index;
+    } else {
+        size_t remaining = lst->size - index;
+        block = lst->last_block;
+        while (remaining > block->count) {
+            remaining -= block->count;
+            block = block->prev;
+        }
+        *offset = block->count - remaining;
+    }
+    return block;
+}
+
+/*
+ * Stores a copy of data at offset in a block that has room for it.
+ */
+cstd_inline void 
+cstd_list_block_insert(list_t* lst, list_block_t* block, size_t offset,
+                       const void* data) {
+    unsigned char* slot = cstd_list_block_element(lst, block, offset);
+    memmove(slot + lst->element_size, slot,
+            (block->count - offset) * lst->element_size);
+    memcpy(slot, data, lst->element_size);
+    block->count++;
+    lst->size++;
+}
+
+cstd_inline void 
+cstd_list_unrolled_insert(list_t* lst, const size_t index, const void* data) {
+    list_block_t* block;
+    size_t offset;
+    if (index == lst->size) {
+        block = lst->last_block;
+        if (!block || block->count == lst->block_capacity) {
+            block = cstd_list_new_block(lst, lst->last_block, NULL);
+        }
+        offset = block->count;
+    } else if (index == 0) {
+        block = lst->first_block;
+        if (block->count == lst->block_capacity) {
+            block = cstd_list_new_block(lst, NULL, lst->first_block);
+        }
+        offset = 0;
+    } else {
+        block = cstd_list_find_block(lst, index, &offset);
+        if (block->count == lst->block_capacity) {
+            // Split the full block, moving its upper half to a new one
+            size_t keep = (lst->block_capacity + 1) / 2;
+            list_block_t* upper = cstd_list_new_block(lst, block, block->next);
+            upper->count = block->count - keep;
+            memcpy(cstd_list_block_element(lst, upper, 0),
+                   cstd_list_block_element(lst, block, keep),
+                   upper->count * lst->element_size);
+            block->count = keep;
+            if (offset > keep) {
+                block = upper;
+                offset -= keep;
+            }
+        }
+    }
+    cstd_list_block_insert(lst, block, offset, data);
+}
+
+/*
+ * Removes the element at index. A block left empty is freed, and a block
+ * that fits into half of a neighbour's capacity together with it is
+ * merged into that neighbour, which keeps blocks at least a quarter full
+ * on average.
+ */
+cstd_inline void 
+cstd_list_unrolled_erase(list_t* lst, const size_t index) {
+    size_t offset;
+    list_block_t* block = cstd_list_find_block(lst, index, &offset);
+    unsigned char* slot = cstd_list_block_element(lst, block, offset);
+    memmove(slot, slot + lst->element_size,
+            (block->count - offset - 1) * lst->element_size);
+    block->count--;
+    lst->size--;
+
+    if (block->count == 0) {
+        cstd_list_free_block(lst, block);
+        return;
+    }
+    list_block_t* next = block->next;
+    if (next && block->count + next->count <= lst->block_capacity / 2) {
+        memcpy(cstd_list_block_element(lst, block, block->count),
+               cstd_list_block_element(lst, next, 0),
+               next->count * lst->element_size);
+        block->count += next->count;
+        cstd_list_free_block(lst, next);
+        return;
+    }
+    list_block_t* prev = block->prev;
+    if (prev && prev->count + block->count <= lst->block_capacity / 2) {
+        memcpy(cstd_list_block_element(lst, prev, prev->count),
+               cstd_list_block_element(lst, block, 0),
+               block->count * lst->element_size);
+        prev->count += block->count;
+        cstd_list_free_block(lst, block);
+    }
+}
+
+/*
+ * Returns the number of bytes allocated for one node. The element is
+ * stored right behind the header, so a node is a single allocation and
+ * data points into it. This is the node size to create a
+ * cstd_node_pool_t with for a list.
+ */
+cstd_inline size_t 
+cstd_list_node_size(const size_t element_size) {
+    return cstd_align_up(sizeof(list_node_t),
+                         cstd_size_alignment(element_size)) + element_size;
+}
+
+cstd_inline void 
+cstd_list_free_node(list_t* lst, list_node_t* node) {
+    cstd_free(lst->allocator, node, cstd_list_node_size(lst->element_size));
 }
 
 cstd_inline void 
 cstd_list_free(list_t* lst) {
+    if (lst->block_capacity) {
+        while (lst->first_block) {
+            cstd_list_free_block(lst, lst->first_block);
+        }
+        lst->size = 0;
+        return;
+    }
     list_node_t* current = lst->head;
     list_node_t* next;
     while (current) {
         next = current->next;
-        free(current->data);
-        free(current);
+        cstd_list_free_node(lst, current);
         current = next;
     }
 }
 
 cstd_inline list_node_t* 
-cstd_list_create_node(void* data, size_t element_size) {
-    list_node_t* node = (list_node_t*)malloc(sizeof(list_node_t));
-    node->data = malloc(element_size);
-    memcpy(node->data, data, element_size);
+cstd_list_create_node(list_t* lst, void* data) {
+    size_t node_size = cstd_list_node_size(lst->element_size);
+    list_node_t* node = (list_node_t*)cstd_alloc(lst->allocator, node_size);
+    node->data = (unsigned char*)node + node_size - lst->element_size;
+    memcpy(node->data, data, lst->element_size);
     node->prev = NULL;
     node->next = NULL;
     return node;
@@ -47,7 +318,11 @@ cstd_list_create_node(void* data, size_t element_size) {
 
 cstd_inline void 
 cstd_list_push_back(list_t* lst, void* data) {
-    list_node_t* node = cstd_list_create_node(data, lst->element_size);
+    if (lst->block_capacity) {
+        cstd_list_unrolled_insert(lst, lst->size, data);
+        return;
+    }
+    list_node_t* node = cstd_list_create_node(lst, data);
     if (lst->tail) {
         lst->tail->next = node;
         node->prev = lst->tail;
@@ -60,7 +335,11 @@ cstd_list_push_back(list_t* lst, void* data) {
 
 cstd_inline void 
 cstd_list_push_front(list_t* lst, void* data) {
-    list_node_t* node = cstd_list_create_node(data, lst->element_size);
+    if (lst->block_capacity) {
+        cstd_list_unrolled_insert(lst, 0, data);
+        return;
+    }
+    list_node_t* node = cstd_list_create_node(lst, data);
     if (lst->head) {
         lst->head->prev = node;
         node->next = lst->head;
@@ -73,6 +352,12 @@ cstd_list_push_front(list_t* lst, void* data) {
 
 cstd_inline void 
 cstd_list_pop_back(list_t* lst) {
+    if (lst->block_capacity) {
+        if (lst->size) {
+            cstd_list_unrolled_erase(lst, lst->size - 1);
+        }
+        return;
+    }
     if (lst->tail) {
         list_node_t* new_tail = lst->tail->prev;
         if (new_tail) {
@@ -80,8 +365,7 @@ cstd_list_pop_back(list_t* lst) {
         } else {
             lst->head = NULL;
         }
-        free(lst->tail->data);
-        free(lst->tail);
+        cstd_list_free_node(lst, lst->tail);
         lst->tail = new_tail;
         lst->size--;
     }
@@ -89,6 +373,12 @@ cstd_list_pop_back(list_t* lst) {
 
 cstd_inline void 
 cstd_list_pop_front(list_t* lst) {
+    if (lst->block_capacity) {
+        if (lst->size) {
+            cstd_list_unrolled_erase(lst, 0);
+        }
+        return;
+    }
     if (lst->head) {
         list_node_t* new_head = lst->head->next;
         if (new_head) {
@@ -96,8 +386,7 @@ cstd_list_pop_front(list_t* lst) {
         } else {
             lst->tail = NULL;
         }
-        free(lst->head->data);
-        free(lst->head);
+        cstd_list_free_node(lst, lst->head);
         lst->head = new_head;
         lst->size--;
     }
@@ -106,6 +395,11 @@ cstd_list_pop_front(list_t* lst) {
 cstd_inline void* 
 cstd_list_at(list_t* lst, const size_t index) {
     assert(index < lst->size);
+    if (lst->block_capacity) {
+        size_t offset;
+        list_block_t* block = cstd_list_find_block(lst, index, &offset);
+        return cstd_list_block_element(lst, block, offset);
+    }
     list_node_t* current = lst->head;
     for (size_t i = 0; i < index; i++) {
         current = current->next;
@@ -121,7 +415,9 @@ cstd_list_empty(list_t* lst) {
 cstd_inline void 
 cstd_list_insert(list_t* lst, const size_t index, void* data) {
     assert(index <= lst->size);
-    if (index == 0) {
+    if (lst->block_capacity) {
+        cstd_list_unrolled_insert(lst, index, data);
+    } else if (index == 0) {
         cstd_list_push_front(lst, data);
     } else if (index == lst->size) {
         cstd_list_push_back(lst, data);
@@ -130,7 +426,7 @@ cstd_list_insert(list_t* lst, const size_t index, void* data) {
         for (size_t i = 0; i < index; i++) {
             current = current->next;
         }
-        list_node_t* new_node = cstd_list_create_node(data, lst->element_size);
+        list_node_t* new_node = cstd_list_create_node(lst, data);
         new_node->prev = current->prev;
         new_node->next = current;
         current->prev->next = new_node;
@@ -142,7 +438,9 @@ cstd_list_insert(list_t* lst, const size_t index, void* data) {
 cstd_inline void 
 cstd_list_erase(list_t* lst, const size_t index) {
     assert(index < lst->size);
-    if (index == 0) {
+    if (lst->block_capacity) {
+        cstd_list_unrolled_erase(lst, index);
+    } else if (index == 0) {
         cstd_list_pop_front(lst);
     } else if (index == lst->size - 1) {
         cstd_list_pop_back(lst);
@@ -153,14 +451,17 @@ cstd_list_erase(list_t* lst, const size_t index) {
         }
         current->prev->next = current->next;
         current->next->prev = current->prev;
-        free(current->data);
-        free(current);
+        cstd_list_free_node(lst, current);
         lst->size--;
     }
 }
 
 cstd_inline void 
 cstd_list_clear(list_t* lst) {
+    if (lst->block_capacity) {
+        cstd_list_free(lst);
+        return;
+    }
     while (!cstd_list_empty(lst)) {
         cstd_list_pop_front(lst);
     }
@@ -170,3 +471,30 @@ cstd_inline size_t
 cstd_list_size(list_t* lst) {
     return lst->size;
 }
+
+/*
+ * Calls callback with every element in order until it returns false.
+ * Works in both layouts and, unlike repeated cstd_list_at calls, visits
+ * each node once.
+ */
+cstd_inline void 
+cstd_list_for_each(list_t* lst, bool (*callback)(void* data, void* context),
+                   void* context) {
+    if (lst->block_capacity) {
+        for (list_block_t* block = lst->first_block; block;
+             block = block->next) {
+            for (size_t i = 0; i < block->count; i++) {
+                if (!callback(cstd_list_block_element(lst, block, i),
+                              context)) {
+                    return;
+                }
+            }
+        }
+        return;
+    }
+    for (list_node_t* node = lst->head; node; node = node->next) {
+        if (!callback(node->data, context)) {
+            return;
+        }
+    }
+}
@@ -2,12 +2,16 @@
 
 #include "cstd_common.h"
 
+/* Upper bound on the height of an AVL tree that fits in memory */
+#define MAP_MAX_HEIGHT 96
+
 typedef struct node_t {
     void*          key;
     void*          value;
     int32_t        height;
     struct node_t* left;
     struct node_t* right;
+    struct node_t* parent;
 } node_t;
 
 typedef struct map_t {
@@ -16,6 +20,7 @@ typedef struct map_t {
     size_t  key_size;
     size_t  value_size;
     int32_t (*key_compare)(const void *, const void *);
+    const cstd_allocator_t* allocator;
 } map_t;
 
 cstd_inline int32_t 
@@ -39,42 +44,71 @@ balance_factor(node_t* node) {
     return height(node->left) - height(node->right);
 }
 
+/*
+ * Offsets of the key and value stored behind a node_t in the same block.
+ */
+cstd_inline size_t 
+cstd_map_key_offset(size_t key_size) {
+    return cstd_align_up(sizeof(node_t), cstd_size_alignment(key_size));
+}
+
+cstd_inline size_t 
+cstd_map_value_offset(size_t key_size, size_t value_size) {
+    return cstd_align_up(cstd_map_key_offset(key_size) + key_size,
+                         cstd_size_alignment(value_size));
+}
+
+/*
+ * Returns the number of bytes allocated for one node, header, key and
+ * value included. This is the node size to create a cstd_node_pool_t
+ * with for a map.
+ */
+cstd_inline size_t 
+cstd_map_node_size(size_t key_size, size_t value_size) {
+    return cstd_map_value_offset(key_size, value_size) + value_size;
+}
+
 cstd_inline node_t* 
-new_node(const void* key, 
-         const void* value, 
-         const size_t key_size, 
-         const size_t value_size) {
-    node_t* node = (node_t*)malloc(sizeof(node_t));
+new_node(map_t* map, 
+         const void* key, 
+         const void* value) {
+    node_t* node = (node_t*)cstd_alloc(
+        map->allocator, cstd_map_node_size(map->key_size, map->value_size));
     if (!node) {
         return NULL;
     }
 
-    node->key = malloc(key_size);
-    if (!node->key) {
-        free(node);
-        return NULL;
-    }
-
-    node->value = malloc(value_size);
-    if (!node->value) {
-        free(node->key);
-        free(node);
-        return NULL;
+    node->key = (unsigned char*)node + cstd_map_key_offset(map->key_size);
+    node->value = (unsigned char*)node +
+                  cstd_map_value_offset(map->key_size, map->value_size);
+    memcpy(node->key, key, map->key_size);
+    if (value) {
+        memcpy(node->value, value, map->value_size);
+    } else {
+        memset(node->value, 0, map->value_size);
     }
-
-    memcpy(node->key, key, key_size);
-    memcpy(node->value, value, value_size);
-    node->left = node->right = NULL;
+    node->left = node->right = node->parent = NULL;
     node->height = 1;
     return node;
 }
 
+cstd_inline void 
+cstd_map_free_node(map_t* map, node_t* node) {
+    cstd_free(map->allocator, node,
+              cstd_map_node_size(map->key_size, map->value_size));
+}
+
 cstd_inline node_t* 
 right_rotate(node_t *y) {
     node_t* x  = y->left;
     node_t* T2 = x->right;
     x->right = y;
     y->left = T2;
+    if (T2) {
+        T2->parent = y;
+    }
+    x->parent = y->parent;
+    y->parent = x;
     y->height = max(height(y->left), height(y->right)) + 1;
     x->height = max(height(x->left), height(x->right)) + 1;
     return x;
@@ -86,50 +120,17 @@ left_rotate(node_t *x) {
     node_t* T2 = y->left;
     y->left   = x;
     x->right  = T2;
+    if (T2) {
+        T2->parent = x;
+    }
+    y->parent = x->parent;
+    x->parent = y;
     x->height = max(height(x->left), height(x->right)) + 1;
     y->height = max(height(y->left), height(y->right)) + 1;
 
     return y;
 }
 
-cstd_inline node_t* 
-insert_recursive(map_t* map, node_t* node, 
-                 const void* key, const void* value) {
-    if (node == NULL) {
-        return new_node(key, value, map->key_size, map->value_size);
-    }
-    int32_t cmp = map->key_compare(key, node->key);
-    if (cmp < 0) {
-        node->left = insert_recursive(map, node->left, key, value);
-    } else if (cmp > 0) {
-        node->right = insert_recursive(map, node->right, key, value);
-    } else {
-        memcpy(node->value, value, map->value_size);
-        return node;
-    }
-    node->height = max(height(node->left), height(node->right)) + 1;
-    int32_t balance = balance_factor(node);
-    // Left Left case
-    if (balance > 1 && map->key_compare(key, node->left->key) < 0) {
-        return right_rotate(node);
-    }
-    // Right Right case
-    if (balance < -1 && map->key_compare(key, node->right->key) > 0) {
-        return left_rotate(node);
-    }
-    // Left Right case
-    if (balance > 1 && map->key_compare(key, node->left->key) > 0) {
-        node->left = left_rotate(node->left);
-        return right_rotate(node);
-    }
-    // Right Left case
-    if (balance < -1 && map->key_compare(key, node->right->key) < 0) {
-        node->right = right_rotate(node->right);
-        return left_rotate(node);
-    }
-    return node;
-}
-
 cstd_inline node_t* 
 find_minimum(node_t* node) {
     if (node->left == NULL) {
@@ -149,8 +150,14 @@ delete_recursive(map_t*  map,
     int32_t cmp = map->key_compare(key, root->key);
     if (cmp < 0) {
         root->left = delete_recursive(map, root->left, key);
+        if (root->left) {
+            root->left->parent = root;
+        }
     } else if (cmp > 0) {
         root->right = delete_recursive(map, root->right, key);
+        if (root->right) {
+            root->right->parent = root;
+        }
     } else {
         if (root->left == NULL || root->right == NULL) {
             node_t *temp = root->left ? root->left : root->right;
@@ -158,16 +165,20 @@ delete_recursive(map_t*  map,
                 temp = root;
                 root = NULL;
             } else {
-                *root = *temp;
+                // Replace the node by its only child and free the node
+                node_t *child = temp;
+                temp = root;
+                root = child;
             }
-            free(temp->key);
-            free(temp->value);
-            free(temp);
+            cstd_map_free_node(map, temp);
         } else {
             node_t* temp = find_minimum(root->right);
             memcpy(root->key, temp->key, map->key_size);
             memcpy(root->value, temp->value, map->value_size);
             root->right = delete_recursive(map, root->right, temp->key);
+            if (root->right) {
+                root->right->parent = root;
+            }
         }
     }
 
@@ -204,55 +215,124 @@ delete_recursive(map_t*  map,
 }
 
 cstd_inline void 
-free_tree(node_t* node) {
+free_tree(map_t* map, node_t* node) {
     if (node == NULL) {
         return;
     }
-    free_tree(node->left);
-    free_tree(node->right);
-    free(node->key);
-    free(node->value);
-    free(node);
+    free_tree(map, node->left);
+    free_tree(map, node->right);
+    cstd_map_free_node(map, node);
 }
 
+/*
+ * Initialize a map whose nodes, keys and values are allocated from
+ * allocator, or with malloc when allocator is NULL.
+ */
 cstd_inline void 
-cstd_map_init(map_t *map, 
-              const size_t key_size, 
-              const size_t value_size, 
-              int32_t (*key_compare)(const void *, const void *)) {
+cstd_map_init_with_allocator(map_t *map, 
+                             const size_t key_size, 
+                             const size_t value_size, 
+                             int32_t (*key_compare)(const void *,
+                                                    const void *),
+                             const cstd_allocator_t* allocator) {
     map->root = NULL;
     map->size = 0;
     map->key_size = key_size;
     map->value_size = value_size;
     map->key_compare = key_compare;
+    map->allocator = cstd_allocator_or_default(allocator);
 }
 
-cstd_inline bool
-inserted_new_key(map_t* map, node_t* node, const void* key, const void* value) {
-    if (node == NULL) {
-        node = new_node(key, value, map->key_size, map->value_size);
-        if (!node) {
-            return false;
+cstd_inline void 
+cstd_map_init(map_t *map, 
+              const size_t key_size, 
+              const size_t value_size, 
+              int32_t (*key_compare)(const void *, const void *)) {
+    cstd_map_init_with_allocator(map, key_size, value_size, key_compare,
+                                 NULL);
+}
+
+/*
+ * Inserts key with value, or overwrites the stored value if key is
+ * already present, in a single descent. The links followed on the way
+ * down are kept on a stack and retraced to rebalance, stopping at the
+ * first node whose height is unchanged. value may be NULL to leave an
+ * existing value untouched; a new entry then starts zeroed. Sets
+ * inserted (if not NULL) to whether a new key was added and returns the
+ * stored value, or NULL if allocation fails.
+ */
+cstd_inline void* 
+cstd_map_upsert(map_t* map, const void* key, const void* value,
+                bool* inserted) {
+    node_t** path[MAP_MAX_HEIGHT];
+    size_t depth = 0;
+    node_t** link = &map->root;
+
+    if (inserted) {
+        *inserted = false;
+    }
+    while (*link) {
+        node_t* node = *link;
+        int32_t cmp = map->key_compare(key, node->key);
+        if (cmp == 0) {
+            if (value) {
+                memcpy(node->value, value, map->value_size);
+            }
+            return node->value;
         }
-        return true;
+        path[depth++] = link;
+        link = (cmp < 0) ? &node->left : &node->right;
     }
-    int32_t cmp = map->key_compare(key, node->key);
-    if (cmp < 0) {
-        return inserted_new_key(map, node->left, key, value);
-    } else if (cmp > 0) {
-        return inserted_new_key(map, node->right, key, value);
-    } else {
-        memcpy(node->value, value, map->value_size);
-        return false;
+
+    node_t* node = new_node(map, key, value);
+    if (!node) {
+        return NULL;
     }
+    node->parent = depth > 0 ? *path[depth - 1] : NULL;
+    *link = node;
+    map->size++;
+    if (inserted) {
+        *inserted = true;
+    }
+
+    while (depth > 0) {
+        link = path[--depth];
+        node_t* parent = *link;
+        int32_t old_height = parent->height;
+        parent->height = max(height(parent->left), height(parent->right)) + 1;
+        int32_t balance = balance_factor(parent);
+        if (balance > 1) {
+            // Left Right case first turns into Left Left
+            if (balance_factor(parent->left) < 0) {
+                parent->left = left_rotate(parent->left);
+            }
+            *link = right_rotate(parent);
+            break;
+        }
+        if (balance < -1) {
+            // Right Left case first turns into Right Right
+            if (balance_factor(parent->right) > 0) {
+                parent->right = right_rotate(parent->right);
+            }
+            *link = left_rotate(parent);
+            break;
+        }
+        if (parent->height == old_height) {
+            break;
+        }
+    }
+    return node->value;
 }
 
-cstd_inline void 
+/*
+ * Inserts key with value, or overwrites the stored value. Returns true
+ * if a new key was added.
+ */
+cstd_inline bool 
 cstd_map_insert(map_t* map, const void* key, const void *value) {
-    if (inserted_new_key(map, map->root, key, value)) {
-        map->root = insert_recursive(map, map->root, key, value);
-        map->size++;
-    }
+    bool inserted;
+    cstd_map_upsert(map, key, value, &inserted);
+    return inserted;
 }
 
 cstd_inline void* 
@@ -272,10 +352,154 @@ cstd_inline void
 cstd_map_delete(map_t* map, const void* key) {
     if (cstd_map_find(map, key)) {
         map->root = delete_recursive(map, map->root, key);
+        if (map->root) {
+            map->root->parent = NULL;
+        }
         map->size--;
     }
 }
 
+/*
+ * Ordered iteration. A node_t* serves as the iterator and NULL as the
+ * end; node->key and node->value give the entry. Moving to the next or
+ * previous node follows parent pointers, so iterating needs no stack or
+ * allocation and a scan of k entries costs O(log n + k).
+ */
+cstd_inline node_t* 
+cstd_map_first(const map_t* map) {
+    node_t* node = map->root;
+    while (node && node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+cstd_inline node_t* 
+cstd_map_last(const map_t* map) {
+    node_t* node = map->root;
+    while (node && node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+cstd_inline node_t* 
+cstd_map_next(node_t* node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return node;
+    }
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+cstd_inline node_t* 
+cstd_map_prev(node_t* node) {
+    if (node->left) {
+        node = node->left;
+        while (node->right) {
+            node = node->right;
+        }
+        return node;
+    }
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+/*
+ * Returns the first node whose key is not less than key, or NULL.
+ */
+cstd_inline node_t* 
+cstd_map_lower_bound(const map_t* map, const void* key) {
+    node_t* node = map->root;
+    node_t* result = NULL;
+    while (node) {
+        if (map->key_compare(node->key, key) >= 0) {
+            result = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return result;
+}
+
+/*
+ * Returns the first node whose key is greater than key, or NULL.
+ */
+cstd_inline node_t* 
+cstd_map_upper_bound(const map_t* map, const void* key) {
+    node_t* node = map->root;
+    node_t* result = NULL;
+    while (node) {
+        if (map->key_compare(node->key, key) > 0) {
+            result = node;
+            node = node->left;
+        } else {
+            node = node->right;
+        }
+    }
+    return result;
+}
+
+/*
+ * Calls callback on every entry with lo <= key < hi in ascending order.
+ * lo or hi may be NULL for an open end. The scan stops early when the
+ * callback returns false. Being inline, the call can be inlined when
+ * callback is a known function.
+ */
+cstd_inline void 
+cstd_map_for_each_range(const map_t* map, const void* lo, const void* hi,
+                        bool (*callback)(const void* key, void* value,
+                                         void* context),
+                        void* context) {
+    node_t* node = lo ? cstd_map_lower_bound(map, lo) : cstd_map_first(map);
+    while (node) {
+        if (hi && map->key_compare(node->key, hi) >= 0) {
+            break;
+        }
+        if (!callback(node->key, node->value, context)) {
+            break;
+        }
+        node = cstd_map_next(node);
+    }
+}
+
+/*
+ * Same as cstd_map_for_each_range, but visits [lo, hi) in descending
+ * order.
+ */
+cstd_inline void 
+cstd_map_for_each_range_reverse(const map_t* map, const void* lo,
+                                const void* hi,
+                                bool (*callback)(const void* key, void* value,
+                                                 void* context),
+                                void* context) {
+    node_t* node;
+    if (hi) {
+        node = cstd_map_lower_bound(map, hi);
+        node = node ? cstd_map_prev(node) : cstd_map_last(map);
+    } else {
+        node = cstd_map_last(map);
+    }
+    while (node) {
+        if (lo && map->key_compare(node->key, lo) < 0) {
+            break;
+        }
+        if (!callback(node->key, node->value, context)) {
+            break;
+        }
+        node = cstd_map_prev(node);
+    }
+}
+
 cstd_inline size_t 
 cstd_map_size(map_t* map) {
     return map->size;
@@ -288,14 +512,14 @@ cstd_map_empty(map_t* map) {
 
 cstd_inline void 
 cstd_map_clear(map_t* map) {
-    free_tree(map->root);
+    free_tree(map, map->root);
     map->root = NULL;
     map->size = 0;
 }
 
 cstd_inline void 
 cstd_map_free(map_t* map) {
-    free_tree(map->root);
+    free_tree(map, map->root);
     map->root = NULL;
     map->size = 0;
 }
\ No newline at end of file
@@ -4,81 +4,455 @@
 
 #define MULTIMAP_INIT_CAPACITY 16
 
+/* Marks a missing child in the key index */
+#define MULTIMAP_NIL ((size_t)-1)
+
+/* Bytes of values kept inside an entry in compact mode */
+#define MULTIMAP_INLINE_BYTES 16
+
+/* Size of the blocks the compact mode arena carves allocations from */
+#define MULTIMAP_ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Number of power-of-two size classes with their own free list */
+#define MULTIMAP_ARENA_CLASSES 64
+
+/*
+ * An entry groups all values stored under one key. Entries also form an
+ * AVL tree ordered by key; the links are indices into the entry array,
+ * so they stay valid when the array is reallocated. In compact mode the
+ * first values live in inline_values.
+ */
 typedef struct {
-    void* key;
-    vector_t value;
+    void*         key;
+    vector_t      value;
+    size_t        left;
+    size_t        right;
+    unsigned char inline_values[MULTIMAP_INLINE_BYTES];
+    int32_t       height;
 } multimap_entry_t;
 
+typedef struct multimap_arena_block {
+    struct multimap_arena_block* next;
+    size_t                       size;
+} multimap_arena_block_t;
+
+/*
+ * Bump allocator used by compact mode for keys and spilled value
+ * buffers. Buffers given back when a value list outgrows them are kept
+ * on free lists by power-of-two capacity and reused by other keys.
+ * Everything is released at once when the multimap is freed.
+ */
+typedef struct {
+    multimap_arena_block_t* blocks;
+    unsigned char*          cursor;
+    unsigned char*          end;
+    void*                   free_lists[MULTIMAP_ARENA_CLASSES];
+    const cstd_allocator_t* allocator;
+} multimap_arena_t;
+
 typedef struct {
     multimap_entry_t* data;
+    size_t            root;
     size_t            size;
     size_t            capacity;
     size_t            key_size;
     size_t            value_element_size;
     int32_t (*key_cmp)(const void*, const void*);
+    const cstd_allocator_t* allocator;
+    bool              compact;
+    size_t            inline_capacity;
+    multimap_arena_t  arena;
 } multimap_t;
 
+cstd_inline void* 
+cstd_multimap_arena_alloc(multimap_arena_t* arena, const size_t size,
+                          const size_t alignment) {
+    if (arena->cursor) {
+        size_t start = cstd_align_up((size_t)arena->cursor, alignment);
+        if (start + size <= (size_t)arena->end) {
+            arena->cursor = (unsigned char*)(start + size);
+            return (void*)start;
+        }
+    }
+
+    size_t header = cstd_align_up(sizeof(multimap_arena_block_t), 16);
+    if (header + size > MULTIMAP_ARENA_BLOCK_SIZE / 4) {
+        // Large buffers get a block of their own
+        multimap_arena_block_t* block = (multimap_arena_block_t*)cstd_alloc(
+            arena->allocator, header + size);
+        if (!block) {
+            return NULL;
+        }
+        block->next = arena->blocks;
+        block->size = header + size;
+        arena->blocks = block;
+        return (unsigned char*)block + header;
+    }
+
+    multimap_arena_block_t* block = (multimap_arena_block_t*)cstd_alloc(
+        arena->allocator, MULTIMAP_ARENA_BLOCK_SIZE);
+    if (!block) {
+        return NULL;
+    }
+    block->next = arena->blocks;
+    block->size = MULTIMAP_ARENA_BLOCK_SIZE;
+    arena->blocks = block;
+    arena->cursor = (unsigned char*)block + header + size;
+    arena->end = (unsigned char*)block + MULTIMAP_ARENA_BLOCK_SIZE;
+    return (unsigned char*)block + header;
+}
+
+/*
+ * Allocator of compact mode value lists. Their buffers belong to the
+ * entry or the arena, so vector_t functions that would grow a list fail
+ * and freeing one leaves its buffer where it is.
+ */
+cstd_inline void* 
+cstd_multimap_compact_allocate(void* context, size_t size) {
+    cstd_unused(context);
+    cstd_unused(size);
+    return NULL;
+}
+
+cstd_inline void* 
+cstd_multimap_compact_reallocate(void* context, void* data, size_t old_size,
+                                 size_t new_size) {
+    cstd_unused(context);
+    cstd_unused(data);
+    cstd_unused(old_size);
+    cstd_unused(new_size);
+    return NULL;
+}
+
 cstd_inline void 
-cstd_multimap_init(multimap_t* mmap, 
-                   const size_t key_size,
-                   const size_t value_element_size,
-                   int32_t (*key_cmp)(const void*, const void*)) {
+cstd_multimap_compact_deallocate(void* context, void* data, size_t size) {
+    cstd_unused(context);
+    cstd_unused(data);
+    cstd_unused(size);
+}
+
+static const cstd_allocator_t cstd_multimap_compact_allocator = {
+    cstd_multimap_compact_allocate,
+    cstd_multimap_compact_reallocate,
+    cstd_multimap_compact_deallocate,
+    NULL
+};
+
+cstd_inline void 
+cstd_multimap_arena_free(multimap_arena_t* arena) {
+    multimap_arena_block_t* block = arena->blocks;
+    while (block) {
+        multimap_arena_block_t* next = block->next;
+        cstd_free(arena->allocator, block, block->size);
+        block = next;
+    }
+    const cstd_allocator_t* allocator = arena->allocator;
+    memset(arena, 0, sizeof(multimap_arena_t));
+    arena->allocator = allocator;
+}
+
+/*
+ * Initialize a multimap that allocates its entries, keys and value
+ * lists from allocator, or with malloc when allocator is NULL.
+ */
+cstd_inline void 
+cstd_multimap_init_with_allocator(multimap_t* mmap, 
+                                  const size_t key_size,
+                                  const size_t value_element_size,
+                                  int32_t (*key_cmp)(const void*,
+                                                     const void*),
+                                  const cstd_allocator_t* allocator) {
+    mmap->allocator = cstd_allocator_or_default(allocator);
     mmap->data = 
-        (multimap_entry_t*)malloc(MULTIMAP_INIT_CAPACITY * 
-                sizeof(multimap_entry_t));
+        (multimap_entry_t*)cstd_alloc(mmap->allocator,
+                MULTIMAP_INIT_CAPACITY * sizeof(multimap_entry_t));
+    mmap->root = MULTIMAP_NIL;
     mmap->size = 0;
     mmap->capacity = MULTIMAP_INIT_CAPACITY;
     mmap->key_size = key_size;
     mmap->value_element_size = value_element_size;
     mmap->key_cmp = key_cmp;
+    mmap->compact = false;
+    mmap->inline_capacity = 0;
+    memset(&mmap->arena, 0, sizeof(multimap_arena_t));
+    mmap->arena.allocator = mmap->allocator;
+}
+
+cstd_inline void 
+cstd_multimap_init(multimap_t* mmap, 
+                   const size_t key_size,
+                   const size_t value_element_size,
+                   int32_t (*key_cmp)(const void*, const void*)) {
+    cstd_multimap_init_with_allocator(mmap, key_size, value_element_size,
+                                      key_cmp, NULL);
+}
+
+/*
+ * Initialize a multimap in compact mode, meant for many keys with few
+ * values each. Up to MULTIMAP_INLINE_BYTES of values are stored inside
+ * the entry, larger lists move to power-of-two buffers from a shared
+ * arena, and keys are copied into the arena as well, so a key with a
+ * handful of values costs no allocation of its own. The value lists are
+ * read through cstd_multimap_get as usual, but only grow through
+ * cstd_multimap_insert: vector_t functions that would reallocate a list
+ * fail instead.
+ */
+cstd_inline void 
+cstd_multimap_init_compact_with_allocator(
+    multimap_t* mmap, const size_t key_size, const size_t value_element_size,
+    int32_t (*key_cmp)(const void*, const void*),
+    const cstd_allocator_t* allocator) {
+    cstd_multimap_init_with_allocator(mmap, key_size, value_element_size,
+                                      key_cmp, allocator);
+    mmap->compact = true;
+    if (value_element_size > 0 &&
+        cstd_size_alignment(value_element_size) <= sizeof(void*)) {
+        mmap->inline_capacity = MULTIMAP_INLINE_BYTES / value_element_size;
+    }
+}
+
+cstd_inline void 
+cstd_multimap_init_compact(multimap_t* mmap, 
+                           const size_t key_size,
+                           const size_t value_element_size,
+                           int32_t (*key_cmp)(const void*, const void*)) {
+    cstd_multimap_init_compact_with_allocator(mmap, key_size,
+                                              value_element_size, key_cmp,
+                                              NULL);
 }
 
 cstd_inline void 
 cstd_multimap_free(multimap_t* mmap) {
-    for (size_t i = 0; i < mmap->size; i++) {
-        cstd_vector_free(&(mmap->data[i].value));
+    if (mmap->compact) {
+        cstd_multimap_arena_free(&mmap->arena);
+    } else {
+        for (size_t i = 0; i < mmap->size; i++) {
+            cstd_free(mmap->allocator, mmap->data[i].key, mmap->key_size);
+            cstd_vector_free(&(mmap->data[i].value));
+        }
     }
-    free(mmap->data);
+    cstd_free(mmap->allocator, mmap->data,
+              mmap->capacity * sizeof(multimap_entry_t));
 }
 
 cstd_inline void 
 cstd_multimap_resize(multimap_t* mmap) {
     mmap->capacity *= 2;
-    mmap->data = (multimap_entry_t*)realloc(
-        mmap->data, mmap->capacity * sizeof(multimap_entry_t));
+    mmap->data = (multimap_entry_t*)cstd_realloc(
+        mmap->allocator, mmap->data,
+        mmap->capacity / 2 * sizeof(multimap_entry_t),
+        mmap->capacity * sizeof(multimap_entry_t));
+    if (mmap->compact && mmap->inline_capacity > 0) {
+        // Inline value lists moved along with their entries
+        for (size_t i = 0; i < mmap->size; i++) {
+            if (mmap->data[i].value.capacity <= mmap->inline_capacity) {
+                mmap->data[i].value.data = mmap->data[i].inline_values;
+            }
+        }
+    }
 }
 
-cstd_inline multimap_entry_t* 
-cstd_multimap_find_or_insert(multimap_t* mmap, void* key) {
-    for (size_t i = 0; i < mmap->size; i++) {
-        if (mmap->key_cmp(mmap->data[i].key, key) == 0) {
-            return &(mmap->data[i]);
+cstd_inline int32_t 
+cstd_multimap_height(const multimap_t* mmap, const size_t index) {
+    return index == MULTIMAP_NIL ? 0 : mmap->data[index].height;
+}
+
+cstd_inline void 
+cstd_multimap_update_height(multimap_t* mmap, const size_t index) {
+    multimap_entry_t* entry = &(mmap->data[index]);
+    int32_t left = cstd_multimap_height(mmap, entry->left);
+    int32_t right = cstd_multimap_height(mmap, entry->right);
+    entry->height = 1 + (left > right ? left : right);
+}
+
+cstd_inline int32_t 
+cstd_multimap_balance_factor(const multimap_t* mmap, const size_t index) {
+    return cstd_multimap_height(mmap, mmap->data[index].left) -
+           cstd_multimap_height(mmap, mmap->data[index].right);
+}
+
+cstd_inline size_t 
+cstd_multimap_rotate_right(multimap_t* mmap, const size_t index) {
+    size_t left = mmap->data[index].left;
+    mmap->data[index].left = mmap->data[left].right;
+    mmap->data[left].right = index;
+    cstd_multimap_update_height(mmap, index);
+    cstd_multimap_update_height(mmap, left);
+    return left;
+}
+
+cstd_inline size_t 
+cstd_multimap_rotate_left(multimap_t* mmap, const size_t index) {
+    size_t right = mmap->data[index].right;
+    mmap->data[index].right = mmap->data[right].left;
+    mmap->data[right].left = index;
+    cstd_multimap_update_height(mmap, index);
+    cstd_multimap_update_height(mmap, right);
+    return right;
+}
+
+cstd_inline size_t 
+cstd_multimap_rebalance(multimap_t* mmap, const size_t index) {
+    cstd_multimap_update_height(mmap, index);
+    int32_t balance = cstd_multimap_balance_factor(mmap, index);
+    if (balance > 1) {
+        size_t left = mmap->data[index].left;
+        if (cstd_multimap_balance_factor(mmap, left) < 0) {
+            mmap->data[index].left = cstd_multimap_rotate_left(mmap, left);
+        }
+        return cstd_multimap_rotate_right(mmap, index);
+    }
+    if (balance < -1) {
+        size_t right = mmap->data[index].right;
+        if (cstd_multimap_balance_factor(mmap, right) > 0) {
+            mmap->data[index].right = cstd_multimap_rotate_right(mmap, right);
         }
+        return cstd_multimap_rotate_left(mmap, index);
     }
+    return index;
+}
+
+/*
+ * Finds key in the subtree rooted at index, appending a new entry and
+ * linking it in if the key is absent. The index of the entry is stored
+ * in result. Returns the new root of the subtree.
+ */
+cstd_inline size_t 
+cstd_multimap_index_insert(multimap_t* mmap, const size_t index,
+                           const void* key, size_t* result) {
+    if (index == MULTIMAP_NIL) {
+        multimap_entry_t* entry = &(mmap->data[mmap->size]);
+        if (mmap->compact) {
+            entry->key = cstd_multimap_arena_alloc(
+                &mmap->arena, mmap->key_size,
+                cstd_size_alignment(mmap->key_size));
+            entry->value.data = mmap->inline_capacity > 0
+                ? entry->inline_values : NULL;
+            entry->value.size = 0;
+            entry->value.capacity = mmap->inline_capacity;
+            entry->value.element_size = mmap->value_element_size;
+            entry->value.allocator = &cstd_multimap_compact_allocator;
+            entry->value.growth = CSTD_VECTOR_GROWTH_1_5X;
+        } else {
+            entry->key = cstd_alloc(mmap->allocator, mmap->key_size);
+            cstd_vector_init_with_allocator(&(entry->value),
+                                            mmap->value_element_size,
+                                            mmap->allocator);
+        }
+        memcpy(entry->key, key, mmap->key_size);
+        entry->left = MULTIMAP_NIL;
+        entry->right = MULTIMAP_NIL;
+        entry->height = 1;
+        *result = mmap->size++;
+        return *result;
+    }
+
+    int32_t cmp = mmap->key_cmp(key, mmap->data[index].key);
+    if (cmp == 0) {
+        *result = index;
+        return index;
+    }
+    if (cmp < 0) {
+        size_t left = cstd_multimap_index_insert(
+            mmap, mmap->data[index].left, key, result);
+        mmap->data[index].left = left;
+    } else {
+        size_t right = cstd_multimap_index_insert(
+            mmap, mmap->data[index].right, key, result);
+        mmap->data[index].right = right;
+    }
+    return cstd_multimap_rebalance(mmap, index);
+}
+
+/*
+ * Returns the entry for key, adding an empty one if the key is absent.
+ * Keys are looked up in the AVL index, so this is O(log n).
+ */
+cstd_inline multimap_entry_t* 
+cstd_multimap_find_or_insert(multimap_t* mmap, void* key) {
     if (mmap->size == mmap->capacity) {
         cstd_multimap_resize(mmap);
     }
-    mmap->data[mmap->size].key = malloc(mmap->key_size);
-    memcpy(mmap->data[mmap->size].key, key, mmap->key_size);
-    cstd_vector_init(&(mmap->data[mmap->size].value), 
-                       mmap->value_element_size);
-    mmap->size++;
-    return &(mmap->data[mmap->size - 1]);
+    size_t result;
+    mmap->root = cstd_multimap_index_insert(mmap, mmap->root, key, &result);
+    return &(mmap->data[result]);
+}
+
+/*
+ * Appends value to the list of a compact mode entry. A full list moves
+ * to an arena buffer of the next power-of-two capacity, and the buffer
+ * it leaves is put on the free list of its size class.
+ */
+cstd_inline void 
+cstd_multimap_compact_push(multimap_t* mmap, multimap_entry_t* entry,
+                           const void* value) {
+    vector_t* values = &(entry->value);
+    size_t element_size = mmap->value_element_size;
+
+    if (values->size == values->capacity) {
+        size_t capacity = values->capacity * 2;
+        if (capacity * element_size < sizeof(void*)) {
+            capacity = (sizeof(void*) + element_size - 1) / element_size;
+        }
+        size_t size_class = 0;
+        while (((size_t)1 << size_class) < capacity) {
+            size_class++;
+        }
+        capacity = (size_t)1 << size_class;
+
+        void* buffer = mmap->arena.free_lists[size_class];
+        if (buffer) {
+            mmap->arena.free_lists[size_class] = *(void**)buffer;
+        } else {
+            size_t alignment = cstd_size_alignment(element_size);
+            buffer = cstd_multimap_arena_alloc(
+                &mmap->arena, capacity * element_size,
+                alignment > sizeof(void*) ? alignment : sizeof(void*));
+            if (!buffer) {
+                return;
+            }
+        }
+        if (values->size > 0) {
+            memcpy(buffer, values->data, values->size * element_size);
+        }
+
+        if (values->capacity > mmap->inline_capacity) {
+            size_t old_class = 0;
+            while (((size_t)1 << old_class) < values->capacity) {
+                old_class++;
+            }
+            *(void**)values->data = mmap->arena.free_lists[old_class];
+            mmap->arena.free_lists[old_class] = values->data;
+        }
+        values->data = buffer;
+        values->capacity = capacity;
+    }
+
+    memcpy((unsigned char*)values->data + values->size * element_size,
+           value, element_size);
+    values->size++;
 }
 
 cstd_inline void 
 cstd_multimap_insert(multimap_t* mmap, void* key,
                                        void* value) {
     multimap_entry_t* entry = cstd_multimap_find_or_insert(mmap, key);
-    cstd_vector_push_back(&(entry->value), value);
+    if (mmap->compact) {
+        cstd_multimap_compact_push(mmap, entry, value);
+    } else {
+        cstd_vector_push_back(&(entry->value), value);
+    }
 }
 
 cstd_inline vector_t* 
 cstd_multimap_get(multimap_t* mmap, void* key) {
-    for (size_t i = 0; i < mmap->size; i++) {
-        if (mmap->key_cmp(mmap->data[i].key, key) == 0) {
-            return &(mmap->data[i].value);
+    size_t index = mmap->root;
+    while (index != MULTIMAP_NIL) {
+        int32_t cmp = mmap->key_cmp(key, mmap->data[index].key);
+        if (cmp == 0) {
+            return &(mmap->data[index].value);
         }
+        index = cmp < 0 ? mmap->data[index].left : mmap->data[index].right;
     }
     return NULL;
 }
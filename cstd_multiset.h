@@ -2,55 +2,163 @@
 
 #include "cstd_common.h"
 
+/*
+ * AVL node. Equal elements share a node: count is the multiplicity of
+ * data and total the number of elements, multiplicities included, in the
+ * subtree rooted at the node.
+ */
 typedef struct bst_node {
     void* data;
     struct bst_node* left;
     struct bst_node* right;
     unsigned int count;
+    int height;
+    size_t total;
 } bst_node_t;
 
 typedef struct {
     bst_node_t* root;
     size_t element_size;
     int (*compare)(const void*, const void*);
+    const cstd_allocator_t* allocator;
 } multiset_t;
 
-cstd_inline void cstd_multiset_init(multiset_t* set, const size_t element_size,
-                                    int (*compare)(const void*, const void*)) {
+/*
+ * Initialize a multiset whose nodes are allocated from allocator, or
+ * with malloc when allocator is NULL.
+ */
+cstd_inline void cstd_multiset_init_with_allocator(
+    multiset_t* set, const size_t element_size,
+    int (*compare)(const void*, const void*),
+    const cstd_allocator_t* allocator) {
     set->root = NULL;
     set->element_size = element_size;
     set->compare = compare;
+    set->allocator = cstd_allocator_or_default(allocator);
+}
+
+cstd_inline void cstd_multiset_init(multiset_t* set, const size_t element_size,
+                                    int (*compare)(const void*, const void*)) {
+    cstd_multiset_init_with_allocator(set, element_size, compare, NULL);
+}
+
+/*
+ * Returns the number of bytes allocated for one node, which stores its
+ * element right behind the header. This is the node size to create a
+ * cstd_node_pool_t with for a multiset.
+ */
+cstd_inline size_t cstd_multiset_node_size(size_t element_size) {
+    return cstd_align_up(sizeof(bst_node_t),
+                         cstd_size_alignment(element_size)) +
+           element_size;
 }
 
-cstd_inline void cstd_multiset_free_nodes(bst_node_t* node) {
+cstd_inline void cstd_multiset_free_node(multiset_t* set, bst_node_t* node) {
+    cstd_free(set->allocator, node,
+              cstd_multiset_node_size(set->element_size));
+}
+
+cstd_inline void cstd_multiset_free_nodes(multiset_t* set, bst_node_t* node) {
     if (node != NULL) {
-        cstd_multiset_free_nodes(node->left);
-        cstd_multiset_free_nodes(node->right);
-        free(node->data);
-        free(node);
+        cstd_multiset_free_nodes(set, node->left);
+        cstd_multiset_free_nodes(set, node->right);
+        cstd_multiset_free_node(set, node);
     }
 }
 
 cstd_inline void cstd_multiset_free(multiset_t* set) {
-    cstd_multiset_free_nodes(set->root);
+    cstd_multiset_free_nodes(set, set->root);
     set->root = NULL;
 }
 
-cstd_inline bst_node_t* cstd_multiset_create_node(const void* data,
-                                                  const size_t element_size) {
-    bst_node_t* new_node = (bst_node_t*)malloc(sizeof(bst_node_t));
-    new_node->data = malloc(element_size);
-    memcpy(new_node->data, data, element_size);
+cstd_inline bst_node_t* cstd_multiset_create_node(multiset_t* set,
+                                                  const void* data) {
+    size_t node_size = cstd_multiset_node_size(set->element_size);
+    bst_node_t* new_node =
+        (bst_node_t*)cstd_alloc(set->allocator, node_size);
+    new_node->data = (unsigned char*)new_node + node_size - set->element_size;
+    memcpy(new_node->data, data, set->element_size);
     new_node->left = NULL;
     new_node->right = NULL;
     new_node->count = 1;
+    new_node->height = 1;
+    new_node->total = 1;
     return new_node;
 }
 
+cstd_inline size_t cstd_multiset_size_node(const bst_node_t* node) {
+    if (node == NULL) {
+        return 0;
+    }
+    return node->total;
+}
+
+cstd_inline void cstd_multiset_update_total(bst_node_t* node) {
+    node->total = node->count + cstd_multiset_size_node(node->left) +
+                  cstd_multiset_size_node(node->right);
+}
+
+cstd_inline int cstd_multiset_height(const bst_node_t* node) {
+    return node ? node->height : 0;
+}
+
+cstd_inline void cstd_multiset_update(bst_node_t* node) {
+    int left = cstd_multiset_height(node->left);
+    int right = cstd_multiset_height(node->right);
+    node->height = 1 + (left > right ? left : right);
+    cstd_multiset_update_total(node);
+}
+
+cstd_inline int cstd_multiset_balance_factor(const bst_node_t* node) {
+    return cstd_multiset_height(node->left) -
+           cstd_multiset_height(node->right);
+}
+
+cstd_inline bst_node_t* cstd_multiset_rotate_right(bst_node_t* node) {
+    bst_node_t* left_child = node->left;
+    node->left = left_child->right;
+    left_child->right = node;
+    cstd_multiset_update(node);
+    cstd_multiset_update(left_child);
+    return left_child;
+}
+
+cstd_inline bst_node_t* cstd_multiset_rotate_left(bst_node_t* node) {
+    bst_node_t* right_child = node->right;
+    node->right = right_child->left;
+    right_child->left = node;
+    cstd_multiset_update(node);
+    cstd_multiset_update(right_child);
+    return right_child;
+}
+
+/*
+ * Recomputes height and total of node after one of its subtrees changed
+ * and restores the AVL balance. Returns the new root of the subtree.
+ */
+cstd_inline bst_node_t* cstd_multiset_balance(bst_node_t* node) {
+    cstd_multiset_update(node);
+
+    int balance = cstd_multiset_balance_factor(node);
+    if (balance > 1) {
+        if (cstd_multiset_balance_factor(node->left) < 0) {
+            node->left = cstd_multiset_rotate_left(node->left);
+        }
+        return cstd_multiset_rotate_right(node);
+    }
+    if (balance < -1) {
+        if (cstd_multiset_balance_factor(node->right) > 0) {
+            node->right = cstd_multiset_rotate_right(node->right);
+        }
+        return cstd_multiset_rotate_left(node);
+    }
+    return node;
+}
+
 cstd_inline void cstd_multiset_insert_node(multiset_t* set, bst_node_t** node,
                                            const void* data) {
     if (*node == NULL) {
-        *node = cstd_multiset_create_node(data, set->element_size);
+        *node = cstd_multiset_create_node(set, data);
     } else {
         int comparison = set->compare(data, (*node)->data);
         if (comparison < 0) {
@@ -60,6 +168,7 @@ cstd_inline void cstd_multiset_insert_node(multiset_t* set, bst_node_t** node,
         } else {
             (*node)->count++;
         }
+        *node = cstd_multiset_balance(*node);
     }
 }
 
@@ -92,14 +201,6 @@ cstd_inline bool cstd_multiset_empty(const multiset_t* set) {
     return set->root == NULL;
 }
 
-cstd_inline size_t cstd_multiset_size_node(const bst_node_t* node) {
-    if (node == NULL) {
-        return 0;
-    }
-    return node->count + cstd_multiset_size_node(node->left) +
-           cstd_multiset_size_node(node->right);
-}
-
 cstd_inline size_t cstd_multiset_size(const multiset_t* set) {
     return cstd_multiset_size_node(set->root);
 }
@@ -115,12 +216,11 @@ cstd_inline bst_node_t* cstd_multiset_remove_min_node(multiset_t* set,
                                                       bst_node_t* node) {
     if (node->left == NULL) {
         bst_node_t* right = node->right;
-        free(node->data);
-        free(node);
+        cstd_multiset_free_node(set, node);
         return right;
     }
     node->left = cstd_multiset_remove_min_node(set, node->left);
-    return node;
+    return cstd_multiset_balance(node);
 }
 
 cstd_inline bst_node_t* cstd_multiset_remove_node(multiset_t* set,
@@ -141,14 +241,12 @@ cstd_inline bst_node_t* cstd_multiset_remove_node(multiset_t* set,
         } else {
             if (node->left == NULL) {
                 bst_node_t* right = node->right;
-                free(node->data);
-                free(node);
+                cstd_multiset_free_node(set, node);
                 return right;
             }
             if (node->right == NULL) {
                 bst_node_t* left = node->left;
-                free(node->data);
-                free(node);
+                cstd_multiset_free_node(set, node);
                 return left;
             }
             bst_node_t* min_right = cstd_multiset_min_node(node->right);
@@ -157,7 +255,7 @@ cstd_inline bst_node_t* cstd_multiset_remove_node(multiset_t* set,
             node->right = cstd_multiset_remove_min_node(set, node->right);
         }
     }
-    return node;
+    return cstd_multiset_balance(node);
 }
 
 cstd_inline void cstd_multiset_remove(multiset_t* set, void* data) {
@@ -171,3 +269,52 @@ cstd_inline void* cstd_multiset_data(const bst_node_t* node) {
 cstd_inline unsigned int cstd_multiset_count(const bst_node_t* node) {
     return node->count;
 }
+
+/*
+ * Returns the node holding the k-th smallest element, counting from 0
+ * and including multiplicities, or NULL if k is not less than the size.
+ */
+cstd_inline bst_node_t* cstd_multiset_select(const multiset_t* set, size_t k) {
+    bst_node_t* node = set->root;
+    while (node != NULL) {
+        size_t left_total = cstd_multiset_size_node(node->left);
+        if (k < left_total) {
+            node = node->left;
+        } else if (k < left_total + node->count) {
+            return node;
+        } else {
+            k -= left_total + node->count;
+            node = node->right;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the number of elements less than data.
+ */
+cstd_inline size_t cstd_multiset_rank(const multiset_t* set,
+                                      const void* data) {
+    bst_node_t* node = set->root;
+    size_t rank = 0;
+    while (node != NULL) {
+        if (set->compare(data, node->data) <= 0) {
+            node = node->left;
+        } else {
+            rank += cstd_multiset_size_node(node->left) + node->count;
+            node = node->right;
+        }
+    }
+    return rank;
+}
+
+/*
+ * Returns the number of elements e with lo <= e < hi.
+ */
+cstd_inline size_t cstd_multiset_count_range(const multiset_t* set,
+                                             const void* lo,
+                                             const void* hi) {
+    size_t lo_rank = cstd_multiset_rank(set, lo);
+    size_t hi_rank = cstd_multiset_rank(set, hi);
+    return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
+}
@@ -2,9 +2,14 @@
 
 #include "cstd_common.h"
 
+/*
+ * AVL node. size counts the nodes of the subtree rooted here, which lets
+ * the set answer order-statistic queries in O(log n).
+ */
 typedef struct avl_node {
     void* key;
     int height;
+    size_t size;
     struct avl_node* left;
     struct avl_node* right;
 } avl_node_t;
@@ -16,6 +21,7 @@ typedef struct {
     size_t size;
     size_t key_size;
     compare_func_t compare;
+    const cstd_allocator_t* allocator;
 } cstd_set_t;
 
 cstd_inline int 
@@ -38,6 +44,16 @@ update_height(avl_node_t* node) {
     node->height = 1 + max(height(node->left), height(node->right));
 }
 
+cstd_inline size_t 
+subtree_size(avl_node_t* node) {
+    return node ? node->size : 0;
+}
+
+cstd_inline void 
+update_size(avl_node_t* node) {
+    node->size = 1 + subtree_size(node->left) + subtree_size(node->right);
+}
+
 cstd_inline avl_node_t* 
 rotate_right(avl_node_t* node) {
     avl_node_t* left_child = node->left;
@@ -46,6 +62,8 @@ rotate_right(avl_node_t* node) {
 
     update_height(node);
     update_height(left_child);
+    update_size(node);
+    update_size(left_child);
 
     return left_child;
 }
@@ -58,6 +76,8 @@ rotate_left(avl_node_t* node) {
 
     update_height(node);
     update_height(right_child);
+    update_size(node);
+    update_size(right_child);
 
     return right_child;
 }
@@ -65,6 +85,7 @@ rotate_left(avl_node_t* node) {
 cstd_inline avl_node_t* 
 balance(avl_node_t* node) {
     update_height(node);
+    update_size(node);
 
     if (balance_factor(node) == 2) {
         if (balance_factor(node->left) < 0) {
@@ -81,35 +102,45 @@ balance(avl_node_t* node) {
     return node;
 }
 
+/*
+ * Returns the number of bytes allocated for one node, which stores its
+ * key right behind the header. This is the node size to create a
+ * cstd_node_pool_t with for a set.
+ */
+cstd_inline size_t 
+cstd_set_node_size(size_t key_size) {
+    return cstd_align_up(sizeof(avl_node_t), cstd_size_alignment(key_size)) + key_size;
+}
+
 cstd_inline avl_node_t* 
-new_node(const void* key, size_t key_size) {
-    avl_node_t* node = (avl_node_t*) malloc(sizeof(avl_node_t));
-    node->key = malloc(key_size);
+new_node(const cstd_allocator_t* allocator, const void* key, size_t key_size) {
+    avl_node_t* node = (avl_node_t*) cstd_alloc(allocator, cstd_set_node_size(key_size));
+    node->key = (unsigned char*)node + cstd_set_node_size(key_size) - key_size;
     memcpy(node->key, key, key_size);
     node->height = 1;
+    node->size = 1;
     node->left = NULL;
     node->right = NULL;
     return node;
 }
 
 cstd_inline void 
-free_node(avl_node_t* node) {
-    free(node->key);
-    free(node);
+free_node(const cstd_allocator_t* allocator, avl_node_t* node, size_t key_size) {
+    cstd_free(allocator, node, cstd_set_node_size(key_size));
 }
 
 cstd_inline avl_node_t* 
-insert(avl_node_t* node, const void* key, size_t key_size, compare_func_t compare, bool* inserted) {
+insert(const cstd_allocator_t* allocator, avl_node_t* node, const void* key, size_t key_size, compare_func_t compare, bool* inserted) {
     if (!node) {
         *inserted = true;
-        return new_node(key, key_size);
+        return new_node(allocator, key, key_size);
     }
 
     int cmp = compare(key, node->key);
     if (cmp < 0) {
-        node->left = insert(node->left, key, key_size, compare, inserted);
+        node->left = insert(allocator, node->left, key, key_size, compare, inserted);
     } else if (cmp > 0) {
-        node->right = insert(node->right, key, key_size, compare, inserted);
+        node->right = insert(allocator, node->right, key, key_size, compare, inserted);
     } else {
         *inserted = false;
         return node;
@@ -118,28 +149,39 @@ insert(avl_node_t* node, const void* key, size_t key_size, compare_func_t compar
     return balance(node);
 }
 
+/*
+ * Initialize a set whose nodes and keys are allocated from allocator,
+ * or with malloc when allocator is NULL.
+ */
 cstd_inline void 
-cstd_set_init(cstd_set_t* set, size_t key_size, compare_func_t compare) {
+cstd_set_init_with_allocator(cstd_set_t* set, size_t key_size, compare_func_t compare,
+                             const cstd_allocator_t* allocator) {
     set->root = NULL;
     set->size = 0;
     set->key_size = key_size;
     set->compare = compare;
+    set->allocator = cstd_allocator_or_default(allocator);
 }
 
 cstd_inline void 
-cstd_set_clear_recursive(avl_node_t* node) {
+cstd_set_init(cstd_set_t* set, size_t key_size, compare_func_t compare) {
+    cstd_set_init_with_allocator(set, key_size, compare, NULL);
+}
+
+cstd_inline void 
+cstd_set_clear_recursive(cstd_set_t* set, avl_node_t* node) {
     if (!node) {
         return;
     }
 
-    cstd_set_clear_recursive(node->left);
-    cstd_set_clear_recursive(node->right);
-    free_node(node);
+    cstd_set_clear_recursive(set, node->left);
+    cstd_set_clear_recursive(set, node->right);
+    free_node(set->allocator, node, set->key_size);
 }
 
 cstd_inline void 
 cstd_set_clear(cstd_set_t* set) {
-    cstd_set_clear_recursive(set->root);
+    cstd_set_clear_recursive(set, set->root);
     set->root = NULL;
     set->size = 0;
 }
@@ -147,7 +189,7 @@ cstd_set_clear(cstd_set_t* set) {
 cstd_inline bool 
 cstd_set_insert(cstd_set_t* set, const void* key) {
     bool inserted;
-    set->root = insert(set->root, key, set->key_size, set->compare, &inserted);
+    set->root = insert(set->allocator, set->root, key, set->key_size, set->compare, &inserted);
     if (inserted) {
         set->size++;
     }
@@ -169,7 +211,7 @@ remove_min(avl_node_t* node) {
 }
 
 cstd_inline avl_node_t* 
-remove_node(avl_node_t* node, const void* key, size_t key_size, compare_func_t compare, bool* removed) {
+remove_node(const cstd_allocator_t* allocator, avl_node_t* node, const void* key, size_t key_size, compare_func_t compare, bool* removed) {
     if (!node) {
         *removed = false;
         return NULL;
@@ -177,13 +219,13 @@ remove_node(avl_node_t* node, const void* key, size_t key_size, compare_func_t c
 
     int cmp = compare(key, node->key);
     if (cmp < 0) {
-        node->left = remove_node(node->left, key, key_size, compare, removed);
+        node->left = remove_node(allocator, node->left, key, key_size, compare, removed);
     } else if (cmp > 0) {
-        node->right = remove_node(node->right, key, key_size, compare, removed);
+        node->right = remove_node(allocator, node->right, key, key_size, compare, removed);
     } else {
         avl_node_t* left = node->left;
         avl_node_t* right = node->right;
-        free_node(node);
+        free_node(allocator, node, key_size);
 
         if (!right) {
             *removed = true;
@@ -204,7 +246,7 @@ remove_node(avl_node_t* node, const void* key, size_t key_size, compare_func_t c
 cstd_inline bool 
 cstd_set_erase(cstd_set_t* set, const void* key) {
     bool removed;
-    set->root = remove_node(set->root, key, set->key_size, set->compare, &removed);
+    set->root = remove_node(set->allocator, set->root, key, set->key_size, set->compare, &removed);
     if (removed) {
         set->size--;
     }
@@ -230,6 +272,55 @@ cstd_set_contains(cstd_set_t* set, const void* key) {
     return cstd_set_contains_recursive(set->root, key, set->compare);
 }
 
+/*
+ * Returns the k-th smallest key, counting from 0, or NULL if k is not
+ * less than the size of the set.
+ */
+cstd_inline const void* 
+cstd_set_select(const cstd_set_t* set, size_t k) {
+    avl_node_t* node = set->root;
+    while (node) {
+        size_t left_size = subtree_size(node->left);
+        if (k < left_size) {
+            node = node->left;
+        } else if (k == left_size) {
+            return node->key;
+        } else {
+            k -= left_size + 1;
+            node = node->right;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Returns the number of keys less than key.
+ */
+cstd_inline size_t 
+cstd_set_rank(const cstd_set_t* set, const void* key) {
+    avl_node_t* node = set->root;
+    size_t rank = 0;
+    while (node) {
+        if (set->compare(key, node->key) <= 0) {
+            node = node->left;
+        } else {
+            rank += subtree_size(node->left) + 1;
+            node = node->right;
+        }
+    }
+    return rank;
+}
+
+/*
+ * Returns the number of keys k with lo <= k < hi.
+ */
+cstd_inline size_t 
+cstd_set_count_range(const cstd_set_t* set, const void* lo, const void* hi) {
+    size_t lo_rank = cstd_set_rank(set, lo);
+    size_t hi_rank = cstd_set_rank(set, hi);
+    return hi_rank > lo_rank ? hi_rank - lo_rank : 0;
+}
+
 cstd_inline size_t 
 cstd_set_size(cstd_set_t* set) {
     return set->size;
@@ -0,0 +1,316 @@
+#pragma once
+
+#include "cstd_common.h"
+
+/* Bytes of elements stored inside the small_vector_t itself */
+#define SMALL_VECTOR_INLINE_BYTES 32
+
+/*
+ * Dynamic array with a small-buffer optimization. The first
+ * SMALL_VECTOR_INLINE_BYTES of elements are stored inside the struct,
+ * and the elements only move to the heap once they outgrow it, so
+ * short vectors never allocate. The inline buffer shares space with the
+ * heap pointer and nothing points into the struct, so a small_vector_t
+ * can be moved with memcpy like a vector_t. Elements that need more
+ * than pointer alignment always live on the heap.
+ */
+typedef struct {
+    size_t size;
+    size_t capacity;
+    size_t element_size;
+    const cstd_allocator_t* allocator;
+    union {
+        void*         heap;
+        unsigned char inline_data[SMALL_VECTOR_INLINE_BYTES];
+    } storage;
+} small_vector_t;
+
+/*
+ * Returns the number of elements that fit in the inline buffer.
+ */
+cstd_inline size_t
+cstd_small_vector_inline_capacity(const small_vector_t* vec) {
+    if (vec->element_size == 0 ||
+        cstd_size_alignment(vec->element_size) > sizeof(void*)) {
+        return 0;
+    }
+    return SMALL_VECTOR_INLINE_BYTES / vec->element_size;
+}
+
+/*
+ * Returns true if the elements have moved to the heap.
+ */
+cstd_inline bool
+cstd_small_vector_spilled(const small_vector_t* vec) {
+    return vec->capacity > cstd_small_vector_inline_capacity(vec);
+}
+
+/*
+ * Returns a pointer to the first element, inline or on the heap.
+ */
+cstd_inline void*
+cstd_small_vector_data(small_vector_t* vec) {
+    return cstd_small_vector_spilled(vec) ? vec->storage.heap
+                                          : vec->storage.inline_data;
+}
+
+/*
+ * Initialize a small vector with the given element size, taking any
+ * heap memory from allocator (NULL for malloc). This never allocates.
+ */
+cstd_inline void
+cstd_small_vector_init_with_allocator(small_vector_t* vec,
+                                      const size_t element_size,
+                                      const cstd_allocator_t* allocator) {
+    vec->size = 0;
+    vec->element_size = element_size;
+    vec->allocator = cstd_allocator_or_default(allocator);
+    vec->capacity = cstd_small_vector_inline_capacity(vec);
+}
+
+/*
+ * Initialize a small vector with the given element size.
+ */
+cstd_inline void
+cstd_small_vector_init(small_vector_t* vec, const size_t element_size) {
+    cstd_small_vector_init_with_allocator(vec, element_size, NULL);
+}
+
+/*
+ * Free the heap memory used by a small vector, if any.
+ */
+cstd_inline void
+cstd_small_vector_free(small_vector_t* vec) {
+    if (cstd_small_vector_spilled(vec)) {
+        cstd_free(vec->allocator, vec->storage.heap,
+                  vec->capacity * vec->element_size);
+    }
+    vec->capacity = cstd_small_vector_inline_capacity(vec);
+    vec->size = 0;
+}
+
+/*
+ * Moves the elements to a buffer of exactly new_capacity elements,
+ * which is the inline buffer when they fit in it. Returns false,
+ * leaving the vector unchanged, if the byte size would overflow or the
+ * allocation fails.
+ */
+cstd_inline bool
+cstd_small_vector_set_capacity(small_vector_t* vec,
+                               const size_t new_capacity) {
+    size_t inline_capacity = cstd_small_vector_inline_capacity(vec);
+    size_t old_bytes = vec->capacity * vec->element_size;
+    bool spilled = vec->capacity > inline_capacity;
+    assert(new_capacity >= vec->size);
+
+    if (new_capacity <= inline_capacity) {
+        if (spilled) {
+            void* heap = vec->storage.heap;
+            memcpy(vec->storage.inline_data, heap,
+                   vec->size * vec->element_size);
+            cstd_free(vec->allocator, heap, old_bytes);
+        }
+        vec->capacity = inline_capacity;
+        return true;
+    }
+    if (vec->element_size > 0 &&
+        new_capacity > SIZE_MAX / vec->element_size) {
+        return false;
+    }
+
+    size_t new_bytes = new_capacity * vec->element_size;
+    void* heap;
+    if (spilled) {
+        heap = cstd_realloc(vec->allocator, vec->storage.heap, old_bytes,
+                            new_bytes);
+    } else {
+        heap = cstd_alloc(vec->allocator, new_bytes);
+        if (heap) {
+            memcpy(heap, vec->storage.inline_data,
+                   vec->size * vec->element_size);
+        }
+    }
+    if (!heap) {
+        return false;
+    }
+    vec->storage.heap = heap;
+    vec->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Makes room for count more elements, growing by 1.5 times the
+ * capacity, or more if needed. Returns false if the vector could not
+ * grow.
+ */
+cstd_inline bool
+cstd_small_vector_reserve_more(small_vector_t* vec, const size_t count) {
+    if (count <= vec->capacity - vec->size) {
+        return true;
+    }
+    if (count > SIZE_MAX - vec->size) {
+        return false;
+    }
+    size_t needed = vec->size + count;
+    size_t grown = vec->capacity > SIZE_MAX - vec->capacity / 2
+        ? SIZE_MAX : vec->capacity + vec->capacity / 2;
+    if (grown < needed) {
+        grown = needed;
+    }
+    if (vec->element_size > 0 && grown > SIZE_MAX / vec->element_size) {
+        grown = SIZE_MAX / vec->element_size;
+    }
+    if (grown < needed) {
+        return false;
+    }
+    return cstd_small_vector_set_capacity(vec, grown);
+}
+
+/*
+ * Reserves space for new_capacity elements. Returns false if the space
+ * could not be reserved.
+ */
+cstd_inline bool
+cstd_small_vector_reserve(small_vector_t* vec, const size_t new_capacity) {
+    if (new_capacity > vec->capacity) {
+        return cstd_small_vector_set_capacity(vec, new_capacity);
+    }
+    return true;
+}
+
+/*
+ * Shrinks the capacity to the size, moving the elements back inline
+ * when they fit.
+ */
+cstd_inline void
+cstd_small_vector_shrink_to_fit(small_vector_t* vec) {
+    if (vec->size < vec->capacity) {
+        cstd_small_vector_set_capacity(vec, vec->size);
+    }
+}
+
+/*
+ * Copies element onto the end of the vector. Returns false, leaving
+ * the vector unchanged, if it could not grow.
+ */
+cstd_inline bool
+cstd_small_vector_push_back(small_vector_t* vec, const void* element) {
+    if (vec->size == vec->capacity &&
+        !cstd_small_vector_reserve_more(vec, 1)) {
+        return false;
+    }
+    memcpy((char*)cstd_small_vector_data(vec) +
+           vec->size * vec->element_size, element, vec->element_size);
+    vec->size++;
+    return true;
+}
+
+/*
+ * Appends count elements stored contiguously at elements. Returns
+ * false, leaving the vector unchanged, if it could not grow.
+ */
+cstd_inline bool
+cstd_small_vector_append_n(small_vector_t* vec, const void* elements,
+                           const size_t count) {
+    if (!cstd_small_vector_reserve_more(vec, count)) {
+        return false;
+    }
+    if (count > 0) {
+        memcpy((char*)cstd_small_vector_data(vec) +
+               vec->size * vec->element_size, elements,
+               count * vec->element_size);
+    }
+    vec->size += count;
+    return true;
+}
+
+/*
+ * Removes the last element. If the vector is empty, this function does
+ * nothing.
+ */
+cstd_inline void
+cstd_small_vector_pop_back(small_vector_t* vec) {
+    if (vec->size > 0) {
+        vec->size--;
+    }
+}
+
+/*
+ * Returns a pointer to the element at the specified index, or NULL if
+ * the index is out of bounds. The pointer is invalidated when the
+ * vector grows, shrinks or is moved.
+ */
+cstd_inline void*
+cstd_small_vector_at(small_vector_t* vec, const size_t index) {
+    if (index >= vec->size) {
+        return NULL;
+    }
+    return (char*)cstd_small_vector_data(vec) + index * vec->element_size;
+}
+
+/*
+ * Inserts a copy of element at index. Returns false, leaving the
+ * vector unchanged, if it could not grow.
+ */
+cstd_inline bool
+cstd_small_vector_insert(small_vector_t* vec, const size_t index,
+                         const void* element) {
+    assert(index <= vec->size);
+    if (vec->size == vec->capacity &&
+        !cstd_small_vector_reserve_more(vec, 1)) {
+        return false;
+    }
+    char* data = (char*)cstd_small_vector_data(vec);
+    memmove(data + (index + 1) * vec->element_size,
+            data + index * vec->element_size,
+            (vec->size - index) * vec->element_size);
+    memcpy(data + index * vec->element_size, element, vec->element_size);
+    vec->size++;
+    return true;
+}
+
+/*
+ * Erases the element at the given index.
+ */
+cstd_inline void
+cstd_small_vector_erase(small_vector_t* vec, const size_t index) {
+    assert(index < vec->size);
+    char* data = (char*)cstd_small_vector_data(vec);
+    memmove(data + index * vec->element_size,
+            data + (index + 1) * vec->element_size,
+            (vec->size - index - 1) * vec->element_size);
+    vec->size--;
+}
+
+/*
+ * Clears the vector without releasing its memory.
+ */
+cstd_inline void
+cstd_small_vector_clear(small_vector_t* vec) {
+    vec->size = 0;
+}
+
+/*
+ * Returns true if the vector is empty, false otherwise.
+ */
+cstd_inline bool
+cstd_small_vector_empty(const small_vector_t* vec) {
+    return vec->size == 0;
+}
+
+/*
+ * Returns the number of elements in the vector.
+ */
+cstd_inline size_t
+cstd_small_vector_size(const small_vector_t* vec) {
+    return vec->size;
+}
+
+/*
+ * Returns the number of elements the vector can hold without growing,
+ * inline or on the heap.
+ */
+cstd_inline size_t
+cstd_small_vector_capacity(const small_vector_t* vec) {
+    return vec->capacity;
+}
@@ -2,19 +2,80 @@
 
 #include "cstd_common.h"
 
+/*
+ * Select how the control bytes of the open-addressing layout are scanned.
+ * Define CSTD_NO_SIMD to force the portable scalar loop.
+ */
+#if !defined(CSTD_NO_SIMD) && defined(__AVX2__)
+    #include <immintrin.h>
+    #define CSTD_FLAT_AVX2
+    #define CSTD_FLAT_GROUP_WIDTH 32
+#elif !defined(CSTD_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || \
+                                 (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+    #include <emmintrin.h>
+    #define CSTD_FLAT_SSE2
+    #define CSTD_FLAT_GROUP_WIDTH 16
+#else
+    #define CSTD_FLAT_GROUP_WIDTH 16
+#endif
+
 // Define an initial capacity for the hash table
 #define UNORDERED_MAP_INIT_CAPACITY 16
 
 /* Define a load factor threshold for resizing */
 #define UNORDERED_MAP_MAX_LOAD_FACTOR 0.75
 
-// Define a generic key-value pair
+/*
+ * Number of non-empty buckets an incrementally rehashing map migrates
+ * on every insert, find and erase. Moving more than one bucket per
+ * operation lets a rehash finish before the new table fills up.
+ */
+#define UNORDERED_MAP_REHASH_STEP 4
+
+/*
+ * Control byte values of the open-addressing layout. A full slot stores
+ * the low 7 bits of its hash, so every byte with the high bit set marks
+ * a slot that can take a new entry.
+ */
+#define UNORDERED_MAP_CTRL_EMPTY   ((int8_t)-128)
+#define UNORDERED_MAP_CTRL_DELETED ((int8_t)-2)
+
+/*
+ * Number of keys the batch functions hash and prefetch together before
+ * probing. Large enough to cover memory latency with independent loads,
+ * small enough for the per-batch state to stay in registers and L1.
+ */
+#define UNORDERED_MAP_BATCH_SIZE 16
+
+/*
+ * Define a generic key-value pair. The key and value bytes are stored
+ * directly after the node header in the same allocation: the key at the
+ * start of data, the value map->value_offset bytes later. The node also
+ * caches the mixed hash of its key, so rehashing never calls the hash
+ * function and a chain walk only compares keys whose hashes match.
+ */
 typedef struct key_value_pair_t {
-    void*                    key;
-    void*                    value;
     struct key_value_pair_t* next;
+    size_t                   hash;
+    unsigned char            data[];
 } key_value_pair_t;
 
+/*
+ * Unordered map data structure. By default it is a chained hash table
+ * whose buckets point to linked key_value_pair_t nodes. The bucket count
+ * is always a power of two, so a bucket is selected by masking the mixed
+ * hash rather than by an integer division.
+ *
+ * A map set up with cstd_unordered_map_init_incremental grows without a
+ * full rehash: the old and new bucket arrays stay live together and each
+ * operation migrates a few buckets, in the style of the Redis dict.
+ * While old_buckets is set, entries may be in either array.
+ *
+ * A map set up with cstd_unordered_map_init_flat uses open addressing
+ * instead: keys and values live inline in one slot array, found by
+ * scanning a group of control bytes at a time. All other functions
+ * accept either layout.
+ */
 typedef struct {
     key_value_pair_t** buckets;
     size_t             size;
@@ -23,110 +84,741 @@ typedef struct {
     size_t             value_size;
     uint32_t (*hash_function)(const void *key);
     bool     (*key_equals)(const void *key1, const void *key2);
+    /* Offset of the value from the key in a node or slot */
+    size_t             value_offset;
+    /* Nodes placed by cstd_unordered_map_init_bulk, freed as one block */
+    unsigned char*     node_block;
+    size_t             node_block_size;
+    /* Incremental rehashing, only used when incremental is set */
+    bool               incremental;
+    key_value_pair_t** old_buckets;
+    size_t             old_capacity;
+    size_t             rehash_index;
+    /* Open-addressing layout, only used when flat is set */
+    bool               flat;
+    int8_t*            ctrl;
+    unsigned char*     slots;
+    size_t             slot_size;
+    size_t             growth_left;
+    const cstd_allocator_t* allocator;
 } unordered_map_t;
 
-/* Resize the hash table, rehashing all key-value pairs */
+/*
+ * Returns a pointer to the key stored in a node.
+ */
+cstd_inline void*
+cstd_unordered_map_pair_key(const key_value_pair_t* pair) {
+    return (void*)pair->data;
+}
+
+/*
+ * Returns a pointer to the value stored in a node.
+ */
+cstd_inline void*
+cstd_unordered_map_pair_value(const unordered_map_t* map,
+                              const key_value_pair_t* pair) {
+    return (void*)(pair->data + map->value_offset);
+}
+
+/*
+ * Returns the number of bytes allocated for one node, key and value
+ * included. This is the node size to create a cstd_node_pool_t with for
+ * a chained map.
+ */
+cstd_inline size_t
+cstd_unordered_map_pair_size(const size_t key_size, const size_t value_size) {
+    return sizeof(key_value_pair_t) +
+           cstd_align_up(key_size, cstd_size_alignment(value_size)) +
+           value_size;
+}
+
+/*
+ * Allocates a node holding copies of the key and value in one block.
+ */
+cstd_inline key_value_pair_t*
+cstd_unordered_map_new_pair(const unordered_map_t* map,
+                            const size_t hash,
+                            const void* key,
+                            const void* value) {
+    key_value_pair_t* pair = (key_value_pair_t*)cstd_alloc(
+        map->allocator,
+        cstd_unordered_map_pair_size(map->key_size, map->value_size));
+    if (!pair) {
+        return NULL;
+    }
+    memcpy(pair->data, key, map->key_size);
+    memcpy(pair->data + map->value_offset, value, map->value_size);
+    pair->next = NULL;
+    pair->hash = hash;
+    return pair;
+}
+
+/*
+ * Returns the number of bytes a node occupies when nodes are laid out
+ * back to back in one block.
+ */
+cstd_inline size_t
+cstd_unordered_map_node_size(const unordered_map_t* map) {
+    size_t alignment = sizeof(size_t);
+    if (cstd_size_alignment(map->key_size) > alignment) {
+        alignment = cstd_size_alignment(map->key_size);
+    }
+    if (cstd_size_alignment(map->value_size) > alignment) {
+        alignment = cstd_size_alignment(map->value_size);
+    }
+    return cstd_align_up(sizeof(key_value_pair_t) + map->value_offset +
+                         map->value_size, alignment);
+}
+
+/*
+ * Releases a node. Nodes that live in the bulk node block are only
+ * returned when the whole block is freed.
+ */
+cstd_inline void
+cstd_unordered_map_free_pair(unordered_map_t* map, key_value_pair_t* pair) {
+    unsigned char* address = (unsigned char*)pair;
+    if (address >= map->node_block &&
+        address < map->node_block + map->node_block_size) {
+        return;
+    }
+    cstd_free(map->allocator, pair,
+              cstd_unordered_map_pair_size(map->key_size, map->value_size));
+}
+
+/*
+ * Returns the mixed hash of a key, as cached in the chained nodes.
+ */
+cstd_inline size_t
+cstd_unordered_map_hash(const unordered_map_t* map, const void* key) {
+    return cstd_hash_mix32(map->hash_function(key));
+}
+
+/*
+ * Returns a mask with bit i set when ctrl[i] == h2, for the group of
+ * CSTD_FLAT_GROUP_WIDTH control bytes starting at ctrl.
+ */
+cstd_inline uint32_t
+cstd_unordered_map_group_match(const int8_t* ctrl, const int8_t h2) {
+#if defined(CSTD_FLAT_AVX2)
+    __m256i group = _mm256_loadu_si256((const __m256i*)ctrl);
+    return (uint32_t)_mm256_movemask_epi8(
+        _mm256_cmpeq_epi8(group, _mm256_set1_epi8(h2)));
+#elif defined(CSTD_FLAT_SSE2)
+    __m128i group = _mm_loadu_si128((const __m128i*)ctrl);
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_cmpeq_epi8(group, _mm_set1_epi8(h2)));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < CSTD_FLAT_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] == h2) << i;
+    }
+    return mask;
+#endif
+}
+
+/*
+ * Returns a mask of the slots in the group that are empty or deleted,
+ * that is, whose control byte has the high bit set.
+ */
+cstd_inline uint32_t
+cstd_unordered_map_group_match_free(const int8_t* ctrl) {
+#if defined(CSTD_FLAT_AVX2)
+    return (uint32_t)_mm256_movemask_epi8(
+        _mm256_loadu_si256((const __m256i*)ctrl));
+#elif defined(CSTD_FLAT_SSE2)
+    return (uint32_t)_mm_movemask_epi8(
+        _mm_loadu_si128((const __m128i*)ctrl));
+#else
+    uint32_t mask = 0;
+    for (uint32_t i = 0; i < CSTD_FLAT_GROUP_WIDTH; i++) {
+        mask |= (uint32_t)(ctrl[i] < 0) << i;
+    }
+    return mask;
+#endif
+}
+
+cstd_inline uint32_t
+cstd_unordered_map_group_match_empty(const int8_t* ctrl) {
+    return cstd_unordered_map_group_match(ctrl, UNORDERED_MAP_CTRL_EMPTY);
+}
+
+cstd_inline void*
+cstd_unordered_map_slot_key(const unordered_map_t* map, const size_t index) {
+    return map->slots + index * map->slot_size;
+}
+
+cstd_inline void*
+cstd_unordered_map_slot_value(const unordered_map_t* map, const size_t index) {
+    return map->slots + index * map->slot_size + map->value_offset;
+}
+
+/*
+ * Allocates empty control and slot arrays for the flat layout. The
+ * capacity must be a power of two and a multiple of the group width.
+ */
+cstd_inline bool
+cstd_unordered_map_flat_alloc(unordered_map_t* map, const size_t capacity) {
+    int8_t* ctrl = (int8_t*)cstd_alloc(map->allocator, capacity);
+    unsigned char* slots = (unsigned char*)cstd_alloc(
+        map->allocator, capacity * map->slot_size);
+    if (!ctrl || !slots) {
+        cstd_free(map->allocator, ctrl, capacity);
+        cstd_free(map->allocator, slots, capacity * map->slot_size);
+        return false;
+    }
+    memset(ctrl, UNORDERED_MAP_CTRL_EMPTY, capacity);
+    map->ctrl = ctrl;
+    map->slots = slots;
+    map->capacity = capacity;
+    map->growth_left = capacity - capacity / 8;
+    return true;
+}
+
+/*
+ * Returns the index of the first free slot on the probe sequence of the
+ * given hash. Probing visits whole groups in triangular order, which
+ * covers every group once the group count is a power of two.
+ */
+cstd_inline size_t
+cstd_unordered_map_flat_find_free(const unordered_map_t* map,
+                                  const size_t hash) {
+    size_t group_mask = map->capacity / CSTD_FLAT_GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; step++) {
+        const int8_t* ctrl = map->ctrl + group * CSTD_FLAT_GROUP_WIDTH;
+        uint32_t mask = cstd_unordered_map_group_match_free(ctrl);
+        if (mask) {
+            return group * CSTD_FLAT_GROUP_WIDTH + cstd_ctz32(mask);
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+/* Rebuild the flat table at the given capacity, dropping tombstones */
+cstd_inline void
+cstd_unordered_map_flat_rehash(unordered_map_t* map,
+                               const size_t new_capacity) {
+    int8_t* old_ctrl = map->ctrl;
+    unsigned char* old_slots = map->slots;
+    size_t old_capacity = map->capacity;
+
+    if (!cstd_unordered_map_flat_alloc(map, new_capacity)) {
+        map->ctrl = old_ctrl;
+        map->slots = old_slots;
+        return;
+    }
+    for (size_t i = 0; i < old_capacity; ++i) {
+        if (old_ctrl[i] < 0) {
+            continue;
+        }
+        unsigned char* slot = old_slots + i * map->slot_size;
+        size_t hash = cstd_unordered_map_hash(map, slot);
+        size_t index = cstd_unordered_map_flat_find_free(map, hash);
+        map->ctrl[index] = (int8_t)(hash & 0x7f);
+        memcpy(cstd_unordered_map_slot_key(map, index), slot, map->slot_size);
+    }
+    map->growth_left -= map->size;
+    cstd_free(map->allocator, old_ctrl, old_capacity);
+    cstd_free(map->allocator, old_slots, old_capacity * map->slot_size);
+}
+
+cstd_inline void*
+cstd_unordered_map_flat_find(const unordered_map_t* map,
+                             const size_t hash,
+                             const void* key) {
+    int8_t h2 = (int8_t)(hash & 0x7f);
+    size_t group_mask = map->capacity / CSTD_FLAT_GROUP_WIDTH - 1;
+    size_t group = (hash >> 7) & group_mask;
+    for (size_t step = 1;; step++) {
+        const int8_t* ctrl = map->ctrl + group * CSTD_FLAT_GROUP_WIDTH;
+        uint32_t mask = cstd_unordered_map_group_match(ctrl, h2);
+        while (mask) {
+            size_t index = group * CSTD_FLAT_GROUP_WIDTH + cstd_ctz32(mask);
+            if (map->key_equals(cstd_unordered_map_slot_key(map, index), key)) {
+                return cstd_unordered_map_slot_value(map, index);
+            }
+            mask &= mask - 1;
+        }
+        if (cstd_unordered_map_group_match_empty(ctrl)) {
+            return NULL;
+        }
+        group = (group + step) & group_mask;
+    }
+}
+
+cstd_inline void
+cstd_unordered_map_flat_insert(unordered_map_t* map,
+                               const size_t hash,
+                               const void* key,
+                               const void* value) {
+    void* existing = cstd_unordered_map_flat_find(map, hash, key);
+    if (existing) {
+        memcpy(existing, value, map->value_size);
+        return;
+    }
+
+    size_t index = cstd_unordered_map_flat_find_free(map, hash);
+    if (map->growth_left == 0 && map->ctrl[index] == UNORDERED_MAP_CTRL_EMPTY) {
+        // Grow when live entries dominate, otherwise only purge tombstones
+        size_t new_capacity = map->capacity;
+        if (map->size * 2 >= map->capacity - map->capacity / 8) {
+            new_capacity *= 2;
+        }
+        cstd_unordered_map_flat_rehash(map, new_capacity);
+        if (map->growth_left == 0) {
+            return;
+        }
+        index = cstd_unordered_map_flat_find_free(map, hash);
+    }
+    if (map->ctrl[index] == UNORDERED_MAP_CTRL_EMPTY) {
+        map->growth_left--;
+    }
+    map->ctrl[index] = (int8_t)(hash & 0x7f);
+    memcpy(cstd_unordered_map_slot_key(map, index), key, map->key_size);
+    memcpy(cstd_unordered_map_slot_value(map, index), value, map->value_size);
+    map->size++;
+}
+
+cstd_inline void
+cstd_unordered_map_flat_erase(unordered_map_t* map,
+                              const size_t hash,
+                              const void* key) {
+    void* value = cstd_unordered_map_flat_find(map, hash, key);
+    if (!value) {
+        return;
+    }
+    size_t index =
+        (size_t)((unsigned char*)value - map->slots) / map->slot_size;
+    size_t group = index & ~(size_t)(CSTD_FLAT_GROUP_WIDTH - 1);
+
+    /*
+     * Probing only moves past a group that has no empty slot, so the slot
+     * can become empty again if its group already holds an empty one.
+     */
+    if (cstd_unordered_map_group_match_empty(map->ctrl + group)) {
+        map->ctrl[index] = UNORDERED_MAP_CTRL_EMPTY;
+        map->growth_left++;
+    } else {
+        map->ctrl[index] = UNORDERED_MAP_CTRL_DELETED;
+    }
+    map->size--;
+}
+
+/*
+ * Returns the node holding the key in one bucket chain, or NULL.
+ */
+cstd_inline key_value_pair_t*
+cstd_unordered_map_chain_find(const unordered_map_t* map,
+                              key_value_pair_t* pair,
+                              const size_t hash,
+                              const void* key) {
+    while (pair) {
+        if (pair->hash == hash && map->key_equals(pair->data, key)) {
+            return pair;
+        }
+        pair = pair->next;
+    }
+    return NULL;
+}
+
+/*
+ * Unlinks and frees the node holding the key from the chain starting at
+ * *bucket. Returns true if the key was found.
+ */
+cstd_inline bool
+cstd_unordered_map_chain_erase(unordered_map_t* map,
+                               key_value_pair_t** bucket,
+                               const size_t hash,
+                               const void* key) {
+    key_value_pair_t *pair = *bucket;
+    key_value_pair_t *prev = NULL;
+
+    while (pair) {
+        if (pair->hash == hash && map->key_equals(pair->data, key)) {
+            if (prev) {
+                prev->next = pair->next;
+            } else {
+                *bucket = pair->next;
+            }
+
+            cstd_unordered_map_free_pair(map, pair);
+            map->size--;
+            return true;
+        }
+        prev = pair;
+        pair = pair->next;
+    }
+    return false;
+}
+
+/*
+ * Starts an incremental rehash into a new bucket array. Nodes stay in
+ * the old array until cstd_unordered_map_rehash_step moves them.
+ */
+cstd_inline void
+cstd_unordered_map_rehash_start(unordered_map_t* map,
+                                const size_t new_capacity) {
+    key_value_pair_t **new_buckets = (key_value_pair_t**)cstd_calloc(
+        map->allocator, new_capacity, sizeof(key_value_pair_t*));
+    if (!new_buckets) {
+        return;
+    }
+    map->old_buckets = map->buckets;
+    map->old_capacity = map->capacity;
+    map->rehash_index = 0;
+    map->buckets = new_buckets;
+    map->capacity = new_capacity;
+}
+
+/*
+ * Migrates up to bucket_count non-empty buckets from the old array to
+ * the new one, visiting at most ten empty buckets per requested bucket
+ * so that the cost of a single call stays bounded. Frees the old array
+ * once it has been drained.
+ */
+cstd_inline void
+cstd_unordered_map_rehash_step(unordered_map_t* map, size_t bucket_count) {
+    size_t empty_visits = bucket_count * 10;
+    while (bucket_count > 0 && map->rehash_index < map->old_capacity) {
+        key_value_pair_t *pair = map->old_buckets[map->rehash_index];
+        if (!pair) {
+            map->rehash_index++;
+            if (--empty_visits == 0) {
+                break;
+            }
+            continue;
+        }
+        while (pair) {
+            key_value_pair_t *next = pair->next;
+            size_t index = pair->hash & (map->capacity - 1);
+            pair->next = map->buckets[index];
+            map->buckets[index] = pair;
+            pair = next;
+        }
+        map->old_buckets[map->rehash_index++] = NULL;
+        bucket_count--;
+    }
+    if (map->rehash_index >= map->old_capacity) {
+        cstd_free(map->allocator, map->old_buckets,
+                  map->old_capacity * sizeof(key_value_pair_t*));
+        map->old_buckets = NULL;
+        map->old_capacity = 0;
+        map->rehash_index = 0;
+    }
+}
+
+/*
+ * Completes a pending incremental rehash, if any.
+ */
+cstd_inline void
+cstd_unordered_map_rehash_finish(unordered_map_t* map) {
+    while (map->old_buckets) {
+        cstd_unordered_map_rehash_step(map, map->old_capacity);
+    }
+}
+
+/* 
+ * Resize the hash table, rehashing all key-value pairs. The capacity is
+ * rounded up to a power of two, and for the flat layout also up to one
+ * that holds every entry within the 7/8 load limit.
+ */
 cstd_inline void 
 cstd_unordered_map_resize_and_rehash(unordered_map_t* map, 
-                                     const size_t new_capacity) {
-    key_value_pair_t **new_buckets =
-        (key_value_pair_t**)calloc(new_capacity, sizeof(key_value_pair_t*));
+                                     size_t new_capacity) {
+    new_capacity = cstd_next_pow2(new_capacity);
+    if (map->flat) {
+        if (new_capacity < CSTD_FLAT_GROUP_WIDTH) {
+            new_capacity = CSTD_FLAT_GROUP_WIDTH;
+        }
+        while (new_capacity - new_capacity / 8 < map->size) {
+            new_capacity *= 2;
+        }
+        cstd_unordered_map_flat_rehash(map, new_capacity);
+        return;
+    }
+    cstd_unordered_map_rehash_finish(map);
+    key_value_pair_t **new_buckets = (key_value_pair_t**)cstd_calloc(
+        map->allocator, new_capacity, sizeof(key_value_pair_t*));
+    if (!new_buckets) {
+        return;
+    }
     for (size_t i = 0; i < map->capacity; ++i) {
         key_value_pair_t *pair = map->buckets[i];
         while (pair) {
             key_value_pair_t *next = pair->next;
-            unsigned int hash = map->hash_function(pair->key);
-            size_t index = hash % new_capacity;
+            size_t index = pair->hash & (new_capacity - 1);
             pair->next = new_buckets[index];
             new_buckets[index] = pair;
             pair = next;
         }
     }
-    free(map->buckets);
+    cstd_free(map->allocator, map->buckets,
+              map->capacity * sizeof(key_value_pair_t*));
     map->buckets = new_buckets;
     map->capacity = new_capacity;
 }
 
+/*
+ * Initialize a chained map whose buckets and nodes are allocated from
+ * allocator, or with malloc when allocator is NULL.
+ */
+cstd_inline void
+cstd_unordered_map_init_with_allocator(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    const cstd_allocator_t *allocator) {
+    map->allocator = cstd_allocator_or_default(allocator);
+    map->buckets = (key_value_pair_t**)cstd_calloc(
+        map->allocator, UNORDERED_MAP_INIT_CAPACITY,
+        sizeof(key_value_pair_t*));
+    map->size = 0;
+    map->capacity = UNORDERED_MAP_INIT_CAPACITY;
+    map->key_size = key_size;
+    map->value_size = value_size;
+    map->hash_function = hash_function;
+    map->key_equals = key_equals;
+    map->value_offset =
+        cstd_align_up(key_size, cstd_size_alignment(value_size));
+    map->node_block = NULL;
+    map->node_block_size = 0;
+    map->incremental = false;
+    map->old_buckets = NULL;
+    map->old_capacity = 0;
+    map->rehash_index = 0;
+    map->flat = false;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->slot_size = 0;
+    map->growth_left = 0;
+}
+
 cstd_inline void 
 cstd_unordered_map_init(
     unordered_map_t *map, const size_t key_size, const size_t value_size,
     uint32_t (*hash_function)(const void *key),
     bool (*key_equals)(const void *key1, const void *key2)) {
-    map->buckets = (key_value_pair_t**)calloc(UNORDERED_MAP_INIT_CAPACITY,
-                                             sizeof(key_value_pair_t*));
+    cstd_unordered_map_init_with_allocator(map, key_size, value_size,
+                                           hash_function, key_equals, NULL);
+}
+
+/*
+ * Initialize a chained map that rehashes incrementally. Growing the
+ * table never moves more than a few buckets at once, which bounds the
+ * latency of every insert, find and erase at the cost of checking two
+ * bucket arrays while a rehash is in progress.
+ */
+cstd_inline void
+cstd_unordered_map_init_incremental_with_allocator(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    const cstd_allocator_t *allocator) {
+    cstd_unordered_map_init_with_allocator(map, key_size, value_size,
+                                           hash_function, key_equals,
+                                           allocator);
+    map->incremental = true;
+}
+
+cstd_inline void
+cstd_unordered_map_init_incremental(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2)) {
+    cstd_unordered_map_init_incremental_with_allocator(
+        map, key_size, value_size, hash_function, key_equals, NULL);
+}
+
+/*
+ * Initialize a map that uses the open-addressing layout. Keys and values
+ * are copied into a flat slot array, so a lookup touches one group of
+ * control bytes and then the matching slot, with no pointer chasing.
+ * Pointers returned by cstd_unordered_map_find are invalidated by the
+ * next insertion.
+ */
+cstd_inline void
+cstd_unordered_map_init_flat_with_allocator(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    const cstd_allocator_t *allocator) {
+    size_t key_align = cstd_size_alignment(key_size);
+    size_t value_align = cstd_size_alignment(value_size);
+    size_t slot_align = key_align > value_align ? key_align : value_align;
+    size_t capacity = UNORDERED_MAP_INIT_CAPACITY;
+    if (capacity < CSTD_FLAT_GROUP_WIDTH) {
+        capacity = CSTD_FLAT_GROUP_WIDTH;
+    }
+
+    map->allocator = cstd_allocator_or_default(allocator);
+    map->buckets = NULL;
     map->size = 0;
-    map->capacity = UNORDERED_MAP_INIT_CAPACITY;
+    map->capacity = 0;
     map->key_size = key_size;
     map->value_size = value_size;
     map->hash_function = hash_function;
     map->key_equals = key_equals;
+    map->node_block = NULL;
+    map->node_block_size = 0;
+    map->incremental = false;
+    map->old_buckets = NULL;
+    map->old_capacity = 0;
+    map->rehash_index = 0;
+    map->flat = true;
+    map->ctrl = NULL;
+    map->slots = NULL;
+    map->value_offset = cstd_align_up(key_size, value_align);
+    map->slot_size = cstd_align_up(map->value_offset + value_size, slot_align);
+    map->growth_left = 0;
+    cstd_unordered_map_flat_alloc(map, capacity);
+}
+
+cstd_inline void
+cstd_unordered_map_init_flat(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2)) {
+    cstd_unordered_map_init_flat_with_allocator(
+        map, key_size, value_size, hash_function, key_equals, NULL);
 }
 
 cstd_inline void 
 cstd_unordered_map_free(unordered_map_t *map) {
+    if (map->flat) {
+        cstd_free(map->allocator, map->ctrl, map->capacity);
+        cstd_free(map->allocator, map->slots,
+                  map->capacity * map->slot_size);
+        map->ctrl = NULL;
+        map->slots = NULL;
+        return;
+    }
     if (map->buckets) {
         for (size_t i = 0; i < map->capacity; i++) {
             key_value_pair_t *pair = map->buckets[i];
             while (pair) {
                 key_value_pair_t *next = pair->next;
-                free(pair->key);
-                free(pair->value);
-                free(pair);
+                cstd_unordered_map_free_pair(map, pair);
                 pair = next;
             }
         }
-        free(map->buckets);
+        cstd_free(map->allocator, map->buckets,
+                  map->capacity * sizeof(key_value_pair_t*));
     }
+    if (map->old_buckets) {
+        for (size_t i = map->rehash_index; i < map->old_capacity; i++) {
+            key_value_pair_t *pair = map->old_buckets[i];
+            while (pair) {
+                key_value_pair_t *next = pair->next;
+                cstd_unordered_map_free_pair(map, pair);
+                pair = next;
+            }
+        }
+        cstd_free(map->allocator, map->old_buckets,
+                  map->old_capacity * sizeof(key_value_pair_t*));
+        map->old_buckets = NULL;
+    }
+    cstd_free(map->allocator, map->node_block, map->node_block_size);
+    map->node_block = NULL;
+    map->node_block_size = 0;
+}
+
+/*
+ * Looks up a key whose hash was already computed with
+ * cstd_unordered_map_hash. Unlike cstd_unordered_map_find it never
+ * migrates buckets of an incremental rehash, so it does not modify the
+ * map.
+ */
+cstd_inline void*
+cstd_unordered_map_find_hashed(const unordered_map_t *map,
+                               const size_t hash,
+                               const void *key) {
+    if (map->flat) {
+        return cstd_unordered_map_flat_find(map, hash, key);
+    }
+    size_t index = hash & (map->capacity - 1);
+    key_value_pair_t *pair =
+        cstd_unordered_map_chain_find(map, map->buckets[index], hash, key);
+    if (!pair && map->old_buckets) {
+        index = hash & (map->old_capacity - 1);
+        pair = cstd_unordered_map_chain_find(map, map->old_buckets[index],
+                                             hash, key);
+    }
+    return pair ? pair->data + map->value_offset : NULL;
 }
 
 cstd_inline void*
 cstd_unordered_map_find(unordered_map_t *map,
                         const void *key) {
-    unsigned int hash = map->hash_function(key);
-    size_t index = hash % map->capacity;
-    key_value_pair_t *pair = map->buckets[index];
-    while (pair) {
-        if (map->key_equals(pair->key, key)) {
-            return pair->value;
-        }
-        pair = pair->next;
+    if (map->old_buckets) {
+        cstd_unordered_map_rehash_step(map, UNORDERED_MAP_REHASH_STEP);
     }
-    return NULL;
+    return cstd_unordered_map_find_hashed(
+        map, cstd_unordered_map_hash(map, key), key);
 }
 
-cstd_inline void 
-cstd_unordered_map_insert(unordered_map_t *map,
-                          const void *key, 
-                          const void *value) {
+/*
+ * Inserts a key whose hash was already computed with
+ * cstd_unordered_map_hash.
+ */
+cstd_inline void
+cstd_unordered_map_insert_hashed(unordered_map_t *map,
+                                 const size_t hash,
+                                 const void *key,
+                                 const void *value) {
+    if (map->flat) {
+        cstd_unordered_map_flat_insert(map, hash, key, value);
+        return;
+    }
+    if (map->old_buckets) {
+        cstd_unordered_map_rehash_step(map, UNORDERED_MAP_REHASH_STEP);
+    }
     if (map->size >= map->capacity * UNORDERED_MAP_MAX_LOAD_FACTOR) {
         size_t new_capacity = map->capacity * 2;
-        cstd_unordered_map_resize_and_rehash(map, new_capacity);
+        if (!map->incremental) {
+            cstd_unordered_map_resize_and_rehash(map, new_capacity);
+        } else if (!map->old_buckets) {
+            cstd_unordered_map_rehash_start(map, new_capacity);
+        }
     }
 
-    unsigned int hash = map->hash_function(key);
-    size_t index = hash % map->capacity;
-    key_value_pair_t *pair = map->buckets[index];
-    while (pair) {
-        if (map->key_equals(pair->key, key)) {
-            memcpy(pair->value, value, map->value_size);
-            return;
-        }
-        pair = pair->next;
+    size_t index = hash & (map->capacity - 1);
+    key_value_pair_t *pair =
+        cstd_unordered_map_chain_find(map, map->buckets[index], hash, key);
+    if (!pair && map->old_buckets) {
+        pair = cstd_unordered_map_chain_find(
+            map, map->old_buckets[hash & (map->old_capacity - 1)], hash, key);
+    }
+    if (pair) {
+        memcpy(pair->data + map->value_offset, value, map->value_size);
+        return;
+    }
+    pair = cstd_unordered_map_new_pair(map, hash, key, value);
+    if (!pair) {
+        return;
     }
-    pair = (key_value_pair_t *)malloc(sizeof(key_value_pair_t));
-    pair->key = malloc(map->key_size);
-    memcpy(pair->key, key, map->key_size);
-    pair->value = malloc(map->value_size);
-    memcpy(pair->value, value, map->value_size);
     pair->next = map->buckets[index];
     map->buckets[index] = pair;
     map->size++;
 }
 
+cstd_inline void 
+cstd_unordered_map_insert(unordered_map_t *map,
+                          const void *key, 
+                          const void *value) {
+    cstd_unordered_map_insert_hashed(
+        map, cstd_unordered_map_hash(map, key), key, value);
+}
+
 cstd_inline void 
 cstd_unordered_map_insert_with_resize(unordered_map_t *map,
                                       const void *key,
                                       const void *value) {
+    // The flat and incremental layouts manage their own growth
+    if (map->flat || map->incremental) {
+        cstd_unordered_map_insert(map, key, value);
+        return;
+    }
+
     // Check if resizing is needed
     if (map->size >= map->capacity * UNORDERED_MAP_MAX_LOAD_FACTOR) {
         size_t new_capacity = map->capacity * 2;
@@ -137,34 +829,220 @@ cstd_unordered_map_insert_with_resize(unordered_map_t *map,
     cstd_unordered_map_insert(map, key, value);
 }
 
+/*
+ * Erases a key whose hash was already computed with
+ * cstd_unordered_map_hash.
+ */
+cstd_inline void
+cstd_unordered_map_erase_hashed(unordered_map_t *map,
+                                const size_t hash,
+                                const void *key) {
+    if (map->flat) {
+        cstd_unordered_map_flat_erase(map, hash, key);
+        return;
+    }
+    if (map->old_buckets) {
+        cstd_unordered_map_rehash_step(map, UNORDERED_MAP_REHASH_STEP);
+    }
+    size_t index = hash & (map->capacity - 1);
+
+    if (!cstd_unordered_map_chain_erase(map, &map->buckets[index],
+                                        hash, key) &&
+        map->old_buckets) {
+        index = hash & (map->old_capacity - 1);
+        cstd_unordered_map_chain_erase(map, &map->old_buckets[index],
+                                       hash, key);
+    }
+}
+
 cstd_inline void 
 cstd_unordered_map_erase(unordered_map_t *map,
                          const void *key) {
-    unsigned int hash = map->hash_function(key);
-    size_t index = hash % map->capacity;
+    cstd_unordered_map_erase_hashed(
+        map, cstd_unordered_map_hash(map, key), key);
+}
 
-    key_value_pair_t *pair = map->buckets[index];
-    key_value_pair_t *prev = NULL;
+/*
+ * Grows the table so that it can hold count entries without rehashing.
+ * Never shrinks it.
+ */
+cstd_inline void
+cstd_unordered_map_reserve(unordered_map_t *map, const size_t count) {
+    if (map->flat) {
+        if (count > map->size + map->growth_left) {
+            cstd_unordered_map_resize_and_rehash(map, count + count / 7 + 1);
+        }
+        return;
+    }
+    size_t capacity = (size_t)(count / UNORDERED_MAP_MAX_LOAD_FACTOR) + 1;
+    if (capacity > map->capacity) {
+        cstd_unordered_map_resize_and_rehash(map, capacity);
+    }
+}
 
-    while (pair) {
-        if (map->key_equals(pair->key, key)) {
-            if (prev) {
-                prev->next = pair->next;
+/*
+ * Looks up count keys stored contiguously in keys, writing a pointer to
+ * each value (or NULL) to values. Keys are processed in batches of
+ * UNORDERED_MAP_BATCH_SIZE: all hashes are computed first, then the
+ * buckets are prefetched, then the first node of each chain, and only
+ * then are the chains walked, so the cache misses of independent
+ * lookups overlap instead of being paid one after the other.
+ */
+cstd_inline void
+cstd_unordered_map_find_batch(unordered_map_t *map,
+                              const void *keys,
+                              const size_t count,
+                              void **values) {
+    size_t hashes[UNORDERED_MAP_BATCH_SIZE];
+    const unsigned char *key_bytes = (const unsigned char *)keys;
+
+    if (map->old_buckets) {
+        cstd_unordered_map_rehash_step(map, UNORDERED_MAP_REHASH_STEP);
+    }
+    for (size_t base = 0; base < count; base += UNORDERED_MAP_BATCH_SIZE) {
+        size_t batch = count - base;
+        if (batch > UNORDERED_MAP_BATCH_SIZE) {
+            batch = UNORDERED_MAP_BATCH_SIZE;
+        }
+        const unsigned char *batch_keys = key_bytes + base * map->key_size;
+
+        for (size_t i = 0; i < batch; i++) {
+            hashes[i] = cstd_unordered_map_hash(
+                map, batch_keys + i * map->key_size);
+            if (map->flat) {
+                size_t group_mask = map->capacity / CSTD_FLAT_GROUP_WIDTH - 1;
+                size_t group = (hashes[i] >> 7) & group_mask;
+                cstd_prefetch(map->ctrl + group * CSTD_FLAT_GROUP_WIDTH);
             } else {
-                map->buckets[index] = pair->next;
+                cstd_prefetch(&map->buckets[hashes[i] & (map->capacity - 1)]);
             }
+        }
+        if (!map->flat) {
+            for (size_t i = 0; i < batch; i++) {
+                key_value_pair_t *pair =
+                    map->buckets[hashes[i] & (map->capacity - 1)];
+                if (pair) {
+                    cstd_prefetch(pair);
+                }
+            }
+        }
+        for (size_t i = 0; i < batch; i++) {
+            values[base + i] = cstd_unordered_map_find_hashed(
+                map, hashes[i], batch_keys + i * map->key_size);
+        }
+    }
+}
 
-            free(pair->key);
-            free(pair->value);
-            free(pair);
-            map->size--;
-            return;
+/*
+ * Inserts count key-value pairs from the contiguous arrays keys and
+ * values. The table is grown once up front to hold every new entry.
+ * Keys are hashed in batches of UNORDERED_MAP_BATCH_SIZE, and the
+ * buckets of a whole batch are prefetched before any of its keys is
+ * inserted, so the cache misses of the batch overlap.
+ */
+cstd_inline void
+cstd_unordered_map_insert_batch(unordered_map_t *map,
+                                const void *keys,
+                                const void *values,
+                                const size_t count) {
+    const unsigned char *key_bytes = (const unsigned char *)keys;
+    const unsigned char *value_bytes = (const unsigned char *)values;
+    size_t hashes[UNORDERED_MAP_BATCH_SIZE];
+
+    // Presize so that no insertion in the batch triggers a rehash
+    cstd_unordered_map_reserve(map, map->size + count);
+
+    for (size_t base = 0; base < count; base += UNORDERED_MAP_BATCH_SIZE) {
+        size_t batch = count - base;
+        if (batch > UNORDERED_MAP_BATCH_SIZE) {
+            batch = UNORDERED_MAP_BATCH_SIZE;
         }
-        prev = pair;
-        pair = pair->next;
+        for (size_t i = 0; i < batch; i++) {
+            hashes[i] = cstd_unordered_map_hash(
+                map, key_bytes + (base + i) * map->key_size);
+            if (map->flat) {
+                size_t group_mask = map->capacity / CSTD_FLAT_GROUP_WIDTH - 1;
+                size_t group = (hashes[i] >> 7) & group_mask;
+                cstd_prefetch(map->ctrl + group * CSTD_FLAT_GROUP_WIDTH);
+            } else {
+                cstd_prefetch(&map->buckets[hashes[i] & (map->capacity - 1)]);
+            }
+        }
+        for (size_t i = 0; i < batch; i++) {
+            cstd_unordered_map_insert_hashed(
+                map, hashes[i], key_bytes + (base + i) * map->key_size,
+                value_bytes + (base + i) * map->value_size);
+        }
+    }
+}
+
+/*
+ * Initialize a chained map from count keys and values stored
+ * contiguously in keys and values. The bucket array is sized once and
+ * all nodes are carved out of a single allocation, so building the map
+ * makes two allocations in total. Later keys overwrite the values of
+ * earlier duplicates. Nodes from the block are released together by
+ * cstd_unordered_map_clear or cstd_unordered_map_free; erasing one only
+ * unlinks it.
+ */
+cstd_inline void
+cstd_unordered_map_init_bulk_with_allocator(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    const void *keys, const void *values, const size_t count,
+    const cstd_allocator_t *allocator) {
+    const unsigned char *key_bytes = (const unsigned char *)keys;
+    const unsigned char *value_bytes = (const unsigned char *)values;
+
+    cstd_unordered_map_init_with_allocator(map, key_size, value_size,
+                                           hash_function, key_equals,
+                                           allocator);
+    cstd_unordered_map_reserve(map, count);
+
+    size_t node_size = cstd_unordered_map_node_size(map);
+    map->node_block =
+        (unsigned char*)cstd_alloc(map->allocator, node_size * count);
+    if (!map->node_block) {
+        cstd_unordered_map_insert_batch(map, keys, values, count);
+        return;
+    }
+    map->node_block_size = node_size * count;
+
+    unsigned char *next_node = map->node_block;
+    for (size_t i = 0; i < count; i++) {
+        const void *key = key_bytes + i * key_size;
+        const void *value = value_bytes + i * value_size;
+        size_t hash = cstd_unordered_map_hash(map, key);
+        size_t index = hash & (map->capacity - 1);
+        key_value_pair_t *pair =
+            cstd_unordered_map_chain_find(map, map->buckets[index], hash, key);
+        if (pair) {
+            memcpy(pair->data + map->value_offset, value, value_size);
+            continue;
+        }
+        pair = (key_value_pair_t *)next_node;
+        next_node += node_size;
+        memcpy(pair->data, key, key_size);
+        memcpy(pair->data + map->value_offset, value, value_size);
+        pair->hash = hash;
+        pair->next = map->buckets[index];
+        map->buckets[index] = pair;
+        map->size++;
     }
 }
 
+cstd_inline void
+cstd_unordered_map_init_bulk(
+    unordered_map_t *map, const size_t key_size, const size_t value_size,
+    uint32_t (*hash_function)(const void *key),
+    bool (*key_equals)(const void *key1, const void *key2),
+    const void *keys, const void *values, const size_t count) {
+    cstd_unordered_map_init_bulk_with_allocator(
+        map, key_size, value_size, hash_function, key_equals, keys, values,
+        count, NULL);
+}
+
 cstd_inline bool 
 cstd_unordered_map_empty(unordered_map_t *map) {
     return map->size == 0;
@@ -177,16 +1055,38 @@ cstd_unordered_map_size(unordered_map_t *map) {
 
 cstd_inline void 
 cstd_unordered_map_clear(unordered_map_t *map) {
+    if (map->flat) {
+        memset(map->ctrl, UNORDERED_MAP_CTRL_EMPTY, map->capacity);
+        map->growth_left = map->capacity - map->capacity / 8;
+        map->size = 0;
+        return;
+    }
     for (size_t i = 0; i < map->capacity; i++) {
         key_value_pair_t *pair = map->buckets[i];
         while (pair) {
             key_value_pair_t *next = pair->next;
-            free(pair->key);
-            free(pair->value);
-            free(pair);
+            cstd_unordered_map_free_pair(map, pair);
             pair = next;
         }
         map->buckets[i] = NULL;
     }
+    if (map->old_buckets) {
+        for (size_t i = map->rehash_index; i < map->old_capacity; i++) {
+            key_value_pair_t *pair = map->old_buckets[i];
+            while (pair) {
+                key_value_pair_t *next = pair->next;
+                cstd_unordered_map_free_pair(map, pair);
+                pair = next;
+            }
+        }
+        cstd_free(map->allocator, map->old_buckets,
+                  map->old_capacity * sizeof(key_value_pair_t*));
+        map->old_buckets = NULL;
+        map->old_capacity = 0;
+        map->rehash_index = 0;
+    }
+    cstd_free(map->allocator, map->node_block, map->node_block_size);
+    map->node_block = NULL;
+    map->node_block_size = 0;
     map->size = 0;
 }
@@ -5,8 +5,13 @@
 #define CSTD_UNORDERED_SET_INIT_BUCKET_COUNT 16
 #define CSTD_UNORDERED_SET_MAX_LOAD_FACTOR 0.75
 
+/*
+ * A node caches the mixed hash of its key, so rehashing never calls the
+ * hash function and lookups only compare keys whose hashes match.
+ */
 typedef struct hash_node {
     void*             key;
+    size_t            hash;
     struct hash_node* next;
 } hash_node_t;
 
@@ -16,7 +21,8 @@ typedef int32_t (*compare_func_t)(const void* a, const void* b);
 /* 
  * Unordered set data structure. It stores data in a contiguous block
  * of memory. It has a dynamic size, which can be changed by adding or
- * removing elements.
+ * removing elements. The bucket count is kept at a power of two so a
+ * bucket is selected by masking the mixed hash.
  */
 typedef struct {
     hash_node_t**  buckets;
@@ -25,21 +31,82 @@ typedef struct {
     size_t         key_size;
     hash_func_t    hash;
     compare_func_t compare;
+    unsigned char* node_block;       // Nodes placed by init_bulk
+    size_t         node_block_size;
+    const cstd_allocator_t* allocator;
 } unordered_set_t;
 
+/*
+ * Returns the number of bytes allocated for one node, which stores its
+ * key right behind the header. This is the node size to create a
+ * cstd_node_pool_t with for a set.
+ */
+cstd_inline size_t
+cstd_unordered_set_node_size(size_t key_size) {
+    return cstd_align_up(sizeof(hash_node_t), cstd_size_alignment(key_size)) +
+           key_size;
+}
+
 cstd_inline hash_node_t* 
-new_hash_node(const void* key, size_t key_size) {
-    hash_node_t* node = (hash_node_t*)malloc(sizeof(hash_node_t));
-    node->key = malloc(key_size);
+new_hash_node(const cstd_allocator_t* allocator,
+              const void* key, size_t key_size, size_t hash) {
+    size_t node_size = cstd_unordered_set_node_size(key_size);
+    hash_node_t* node = (hash_node_t*)cstd_alloc(allocator, node_size);
+    node->key = (unsigned char*)node + node_size - key_size;
     memcpy(node->key, key, key_size);
+    node->hash = hash;
     node->next = NULL;
     return node;
 }
 
 cstd_inline void 
-free_hash_node(hash_node_t* node) {
-    free(node->key);
-    free(node);
+free_hash_node(const cstd_allocator_t* allocator, hash_node_t* node,
+               size_t key_size) {
+    cstd_free(allocator, node, cstd_unordered_set_node_size(key_size));
+}
+
+/*
+ * Frees a node unless it lives in the block allocated by
+ * cstd_unordered_set_init_bulk, which is released as a whole.
+ */
+cstd_inline void
+cstd_unordered_set_free_node(unordered_set_t* set, hash_node_t* node) {
+    unsigned char* address = (unsigned char*)node;
+    if (set->node_block && address >= set->node_block &&
+        address < set->node_block + set->node_block_size) {
+        return;
+    }
+    free_hash_node(set->allocator, node, set->key_size);
+}
+
+/*
+ * Returns the mixed hash of a key, as cached in the nodes.
+ */
+cstd_inline size_t
+cstd_unordered_set_hash(const unordered_set_t* set, const void* key) {
+    return cstd_hash_mix_size(set->hash(key));
+}
+
+/*
+ * Initialize an unordered set whose buckets and nodes are allocated from
+ * allocator, or with malloc when allocator is NULL.
+ */
+cstd_inline void
+cstd_unordered_set_init_with_allocator(unordered_set_t* set,
+                                       size_t key_size, hash_func_t hash,
+                                       compare_func_t compare,
+                                       const cstd_allocator_t* allocator) {
+    set->allocator = cstd_allocator_or_default(allocator);
+    set->buckets = (hash_node_t**)cstd_calloc(
+        set->allocator, CSTD_UNORDERED_SET_INIT_BUCKET_COUNT,
+        sizeof(hash_node_t*));
+    set->size = 0;
+    set->bucket_count = CSTD_UNORDERED_SET_INIT_BUCKET_COUNT;
+    set->key_size = key_size;
+    set->hash = hash;
+    set->compare = compare;
+    set->node_block = NULL;
+    set->node_block_size = 0;
 }
 
 /* 
@@ -50,13 +117,7 @@ cstd_inline void
 cstd_unordered_set_init(unordered_set_t* set,
                         size_t key_size, hash_func_t hash,
                         compare_func_t compare) {
-    set->buckets = (hash_node_t**)calloc(CSTD_UNORDERED_SET_INIT_BUCKET_COUNT,
-                                         sizeof(hash_node_t*));
-    set->size = 0;
-    set->bucket_count = CSTD_UNORDERED_SET_INIT_BUCKET_COUNT;
-    set->key_size = key_size;
-    set->hash = hash;
-    set->compare = compare;
+    cstd_unordered_set_init_with_allocator(set, key_size, hash, compare, NULL);
 }
 
 cstd_inline void 
@@ -65,27 +126,37 @@ cstd_unordered_set_free(unordered_set_t* set) {
         hash_node_t* node = set->buckets[i];
         while (node) {
             hash_node_t* next = node->next;
-            free_hash_node(node);
+            cstd_unordered_set_free_node(set, node);
             node = next;
         }
     }
-    free(set->buckets);
+    cstd_free(set->allocator, set->buckets,
+              set->bucket_count * sizeof(hash_node_t*));
+    cstd_free(set->allocator, set->node_block, set->node_block_size);
+    set->node_block = NULL;
+    set->node_block_size = 0;
 }
 
 /* 
- * Resizes the unordered set to twice the size of the current capacity.
+ * Resizes the unordered set to the given bucket count, rounded up to a
+ * power of two. Nodes are moved using their cached hashes.
  */
 cstd_inline void 
 cstd_unordered_set_resize(unordered_set_t* set,
                           size_t new_bucket_count) {
+    new_bucket_count = cstd_next_pow2(new_bucket_count);
     hash_node_t** new_buckets =
-        (hash_node_t**)calloc(new_bucket_count, sizeof(hash_node_t*));
+        (hash_node_t**)cstd_calloc(set->allocator, new_bucket_count,
+                                   sizeof(hash_node_t*));
+    if (!new_buckets) {
+        return;
+    }
 
     for (size_t i = 0; i < set->bucket_count; i++) {
         hash_node_t* node = set->buckets[i];
         while (node) {
             hash_node_t* next = node->next;
-            size_t new_bucket_index = set->hash(node->key) % new_bucket_count;
+            size_t new_bucket_index = node->hash & (new_bucket_count - 1);
 
             node->next = new_buckets[new_bucket_index];
             new_buckets[new_bucket_index] = node;
@@ -94,11 +165,25 @@ cstd_unordered_set_resize(unordered_set_t* set,
         }
     }
 
-    free(set->buckets);
+    cstd_free(set->allocator, set->buckets,
+              set->bucket_count * sizeof(hash_node_t*));
     set->buckets = new_buckets;
     set->bucket_count = new_bucket_count;
 }
 
+/*
+ * Grows the bucket array so that it can hold count keys without
+ * resizing. Never shrinks it.
+ */
+cstd_inline void
+cstd_unordered_set_reserve(unordered_set_t* set, size_t count) {
+    size_t bucket_count =
+        (size_t)(count / CSTD_UNORDERED_SET_MAX_LOAD_FACTOR) + 1;
+    if (bucket_count > set->bucket_count) {
+        cstd_unordered_set_resize(set, bucket_count);
+    }
+}
+
 /* 
  * Returns true if the key was inserted, false if it already exists.
  */
@@ -110,17 +195,19 @@ cstd_unordered_set_insert(unordered_set_t* set,
         cstd_unordered_set_resize(set, set->bucket_count * 2);
     }
 
-    size_t bucket_index = set->hash(key) % set->bucket_count;
+    size_t hash = cstd_unordered_set_hash(set, key);
+    size_t bucket_index = hash & (set->bucket_count - 1);
     hash_node_t* node = set->buckets[bucket_index];
 
     while (node) {
-        if (set->compare(node->key, key) == 0) {
+        if (node->hash == hash && set->compare(node->key, key) == 0) {
             return false;  // Key already exists in the set
         }
         node = node->next;
     }
 
-    hash_node_t* new_node = new_hash_node(key, set->key_size);
+    hash_node_t* new_node = new_hash_node(set->allocator, key, set->key_size,
+                                          hash);
     new_node->next = set->buckets[bucket_index];
     set->buckets[bucket_index] = new_node;
     set->size++;
@@ -133,18 +220,19 @@ cstd_unordered_set_insert(unordered_set_t* set,
 cstd_inline bool 
 cstd_unordered_set_erase(unordered_set_t* set,
                                           const void* key) {
-    size_t bucket_index = set->hash(key) % set->bucket_count;
+    size_t hash = cstd_unordered_set_hash(set, key);
+    size_t bucket_index = hash & (set->bucket_count - 1);
     hash_node_t* node = set->buckets[bucket_index];
     hash_node_t* prev = NULL;
 
     while (node) {
-        if (set->compare(node->key, key) == 0) {
+        if (node->hash == hash && set->compare(node->key, key) == 0) {
             if (prev) {
                 prev->next = node->next;
             } else {
                 set->buckets[bucket_index] = node->next;
             }
-            free_hash_node(node);
+            cstd_unordered_set_free_node(set, node);
             set->size--;
             return true;
         }
@@ -160,11 +248,12 @@ cstd_unordered_set_erase(unordered_set_t* set,
 cstd_inline bool 
 cstd_unordered_set_find(const unordered_set_t* set,
                         const void* key) {
-    size_t bucket_index = set->hash(key) % set->bucket_count;
+    size_t hash = cstd_unordered_set_hash(set, key);
+    size_t bucket_index = hash & (set->bucket_count - 1);
     hash_node_t* node = set->buckets[bucket_index];
 
     while (node) {
-        if (set->compare(node->key, key) == 0) {
+        if (node->hash == hash && set->compare(node->key, key) == 0) {
             return true;
         }
         node = node->next;
@@ -187,3 +276,72 @@ cstd_inline bool
 cstd_unordered_set_empty(const unordered_set_t* set) {
     return set->size == 0;
 }
+
+/*
+ * Initialize an unordered set from count keys stored contiguously in
+ * keys. The bucket array is sized once and every node is placed, with
+ * its key right behind it, in a single allocation. Duplicate keys are
+ * stored once. Nodes from the block are released together by
+ * cstd_unordered_set_free; erasing one only unlinks it.
+ */
+cstd_inline void
+cstd_unordered_set_init_bulk_with_allocator(unordered_set_t* set,
+                                            size_t key_size, hash_func_t hash,
+                                            compare_func_t compare,
+                                            const void* keys, size_t count,
+                                            const cstd_allocator_t* allocator) {
+    const unsigned char* key_bytes = (const unsigned char*)keys;
+
+    cstd_unordered_set_init_with_allocator(set, key_size, hash, compare,
+                                           allocator);
+    cstd_unordered_set_reserve(set, count);
+
+    /* Same layout as new_hash_node, padded to align the next node */
+    size_t key_offset = cstd_unordered_set_node_size(key_size) - key_size;
+    size_t node_size = cstd_align_up(cstd_unordered_set_node_size(key_size),
+                                     sizeof(void*));
+    set->node_block =
+        (unsigned char*)cstd_alloc(set->allocator, node_size * count);
+    if (!set->node_block) {
+        for (size_t i = 0; i < count; i++) {
+            cstd_unordered_set_insert(set, key_bytes + i * key_size);
+        }
+        return;
+    }
+    set->node_block_size = node_size * count;
+
+    unsigned char* next_node = set->node_block;
+    for (size_t i = 0; i < count; i++) {
+        const void* key = key_bytes + i * key_size;
+        size_t key_hash = cstd_unordered_set_hash(set, key);
+        size_t bucket_index = key_hash & (set->bucket_count - 1);
+        hash_node_t* node = set->buckets[bucket_index];
+        while (node) {
+            if (node->hash == key_hash && set->compare(node->key, key) == 0) {
+                break;
+            }
+            node = node->next;
+        }
+        if (node) {
+            continue;
+        }
+
+        node = (hash_node_t*)next_node;
+        next_node += node_size;
+        node->key = (unsigned char*)node + key_offset;
+        memcpy(node->key, key, key_size);
+        node->hash = key_hash;
+        node->next = set->buckets[bucket_index];
+        set->buckets[bucket_index] = node;
+        set->size++;
+    }
+}
+
+cstd_inline void
+cstd_unordered_set_init_bulk(unordered_set_t* set,
+                             size_t key_size, hash_func_t hash,
+                             compare_func_t compare,
+                             const void* keys, size_t count) {
+    cstd_unordered_set_init_bulk_with_allocator(set, key_size, hash, compare,
+                                                keys, count, NULL);
+}
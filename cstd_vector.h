@@ -4,6 +4,21 @@
 
 #define VECTOR_INIT_CAPACITY 16
 
+/* Granularity of the page-rounded growth policy */
+#define CSTD_VECTOR_PAGE_SIZE 4096
+
+/*
+ * How a full vector grows. 1.5x is the default; 2x trades memory for
+ * fewer reallocations, and the page policy grows by 1.5x and rounds the
+ * buffer up to whole pages, which suits large buffers that the
+ * allocator serves straight from the OS.
+ */
+typedef enum {
+    CSTD_VECTOR_GROWTH_1_5X,
+    CSTD_VECTOR_GROWTH_2X,
+    CSTD_VECTOR_GROWTH_PAGE
+} cstd_vector_growth_t;
+
 /* 
  * Dynamic array data structure. It stores data in a contiguous block
  * of memory. It has a dynamic size, which can be changed by adding or
@@ -14,14 +29,21 @@ typedef struct {
     size_t size;
     size_t capacity;
     size_t element_size;
+    const cstd_allocator_t* allocator;
+    cstd_vector_growth_t growth;
 } vector_t;
 
 /*
- * Initialize a vector with the given element size.
+ * Initialize a vector with the given element size, taking its memory
+ * from allocator (NULL for malloc).
  */
 cstd_inline void 
-cstd_vector_init(vector_t* vec, const size_t element_size) {
-    vec->data = malloc(VECTOR_INIT_CAPACITY * element_size);
+cstd_vector_init_with_allocator(vector_t* vec, const size_t element_size,
+                                const cstd_allocator_t* allocator) {
+    vec->allocator = cstd_allocator_or_default(allocator);
+    vec->growth = CSTD_VECTOR_GROWTH_1_5X;
+    vec->data = cstd_alloc(vec->allocator,
+                           VECTOR_INIT_CAPACITY * element_size);
     if (vec->data) {
         vec->size = 0;
         vec->capacity = VECTOR_INIT_CAPACITY;
@@ -33,6 +55,14 @@ cstd_vector_init(vector_t* vec, const size_t element_size) {
     }
 }
 
+/*
+ * Initialize a vector with the given element size.
+ */
+cstd_inline void 
+cstd_vector_init(vector_t* vec, const size_t element_size) {
+    cstd_vector_init_with_allocator(vec, element_size, NULL);
+}
+
 /*
  * Free the memory used by a vector. This does not free any memory
  * allocated for the elements in the vector.
@@ -40,42 +70,130 @@ cstd_vector_init(vector_t* vec, const size_t element_size) {
 cstd_inline void 
 cstd_vector_free(vector_t* vec) {
     if (vec->data) {
-        free(vec->data);
+        cstd_free(vec->allocator, vec->data,
+                  vec->capacity * vec->element_size);
     }
 }
 
-/* 
- * Resizes the vector to 1.5 times the size of the current capacity.
+/*
+ * Selects the growth policy used when the vector runs out of capacity.
  */
-cstd_inline void
-cstd_vector_resize(vector_t* vec) {
-    size_t old_capacity = vec->capacity;
-    vec->capacity = vec->capacity * 3 / 2;
-    void* new_data = realloc(vec->data, vec->capacity * vec->element_size);
-    if (new_data) {
-        vec->data = new_data;
+cstd_inline void 
+cstd_vector_set_growth(vector_t* vec, const cstd_vector_growth_t growth) {
+    vec->growth = growth;
+}
+
+/*
+ * Returns the largest capacity whose byte size fits in a size_t.
+ */
+cstd_inline size_t 
+cstd_vector_max_capacity(const vector_t* vec) {
+    return vec->element_size ? SIZE_MAX / vec->element_size : SIZE_MAX;
+}
+
+/*
+ * Computes the capacity to grow to so that at least min_capacity
+ * elements fit, following the growth policy and starting from
+ * VECTOR_INIT_CAPACITY when the vector has no buffer. Returns false if
+ * min_capacity elements would overflow a size_t.
+ */
+cstd_inline bool 
+cstd_vector_next_capacity(const vector_t* vec, const size_t min_capacity,
+                          size_t* capacity) {
+    size_t max_capacity = cstd_vector_max_capacity(vec);
+    if (min_capacity > max_capacity) {
+        return false;
+    }
+
+    size_t grown = vec->capacity;
+    if (vec->growth == CSTD_VECTOR_GROWTH_2X) {
+        grown = grown > max_capacity / 2 ? max_capacity : grown * 2;
     } else {
-        vec->capacity = old_capacity;
+        grown = grown > max_capacity - grown / 2 ? max_capacity
+                                                 : grown + grown / 2;
+    }
+    if (grown < VECTOR_INIT_CAPACITY) {
+        grown = VECTOR_INIT_CAPACITY < max_capacity ? VECTOR_INIT_CAPACITY
+                                                    : max_capacity;
+    }
+    if (grown < min_capacity) {
+        grown = min_capacity;
+    }
+    if (vec->growth == CSTD_VECTOR_GROWTH_PAGE && vec->element_size) {
+        size_t bytes = grown * vec->element_size;
+        if (bytes <= SIZE_MAX - (CSTD_VECTOR_PAGE_SIZE - 1)) {
+            grown = cstd_align_up(bytes, CSTD_VECTOR_PAGE_SIZE) /
+                    vec->element_size;
+        }
+    }
+    *capacity = grown;
+    return true;
+}
+
+/*
+ * Moves the elements to a buffer of exactly new_capacity elements.
+ * Returns false, leaving the vector unchanged, if the byte size would
+ * overflow or the allocation fails.
+ */
+cstd_inline bool 
+cstd_vector_set_capacity(vector_t* vec, const size_t new_capacity) {
+    if (new_capacity > cstd_vector_max_capacity(vec)) {
+        return false;
+    }
+    void* new_data = cstd_realloc(vec->allocator, vec->data,
+                                  vec->capacity * vec->element_size,
+                                  new_capacity * vec->element_size);
+    if (!new_data && new_capacity > 0) {
+        return false;
+    }
+    vec->data = new_data;
+    vec->capacity = new_capacity;
+    return true;
+}
+
+/*
+ * Grows the vector to hold at least min_capacity elements, following
+ * the growth policy. If the allocator cannot provide the grown
+ * capacity, as with an allocator whose buffers have a fixed maximum
+ * size, it falls back to exactly min_capacity.
+ */
+cstd_inline bool 
+cstd_vector_grow(vector_t* vec, const size_t min_capacity) {
+    size_t new_capacity;
+    if (!cstd_vector_next_capacity(vec, min_capacity, &new_capacity)) {
+        return false;
     }
+    if (cstd_vector_set_capacity(vec, new_capacity)) {
+        return true;
+    }
+    return new_capacity > min_capacity &&
+           cstd_vector_set_capacity(vec, min_capacity);
+}
+
+/* 
+ * Grows the vector according to its growth policy, by 1.5 times the
+ * current capacity by default. Returns false if the vector could not
+ * grow.
+ */
+cstd_inline bool
+cstd_vector_resize(vector_t* vec) {
+    return vec->capacity < SIZE_MAX &&
+           cstd_vector_grow(vec, vec->capacity + 1);
 }
 
 
 /*
  * This function reserves space in the vector so that it can hold
  * new_capacity elements. If the new capacity is smaller than the
- * current capacity, then this function does nothing.
+ * current capacity, then this function does nothing. Returns false if
+ * the space could not be reserved.
 */
-cstd_inline void 
+cstd_inline bool 
 cstd_vector_reserve(vector_t* vec, const size_t new_capacity) {
     if (new_capacity > vec->capacity) {
-        vec->capacity = new_capacity;
-        void* new_data = realloc(vec->data, vec->capacity * vec->element_size);
-        if (new_data) {
-            vec->data = new_data;
-        } else {
-            vec->capacity = vec->size;
-        }
+        return cstd_vector_set_capacity(vec, new_capacity);
     }
+    return true;
 }
 
 /* 
@@ -85,23 +203,20 @@ cstd_vector_reserve(vector_t* vec, const size_t new_capacity) {
 cstd_inline void 
 cstd_vector_shrink_to_fit(vector_t* vec) {
     if (vec->size < vec->capacity) {
-        vec->capacity = vec->size;
-        void* new_data = realloc(vec->data, vec->capacity * vec->element_size);
-        if (new_data) {
-            vec->data = new_data;
-        }
+        cstd_vector_set_capacity(vec, vec->size);
     }
 }
 
 /*
 * This function pushes an element onto the end of the vector.
 * The element is copied into the vector, and the vector's size
-* is incremented. The vector is resized if it is full.
+* is incremented. The vector is resized if it is full. Returns false,
+* leaving the vector unchanged, if it could not grow.
 */
-cstd_inline void 
+cstd_inline bool 
 cstd_vector_push_back(vector_t* vec, void* element) {
-    if (vec->size == vec->capacity) {
-        cstd_vector_resize(vec);
+    if (vec->size == vec->capacity && !cstd_vector_resize(vec)) {
+        return false;
     }
     memcpy((char*)vec->data +
                   vec->size * 
@@ -109,6 +224,60 @@ cstd_vector_push_back(vector_t* vec, void* element) {
                   element, 
                   vec->element_size);
     vec->size++;
+    return true;
+}
+
+/*
+ * Makes room for count more elements, growing by the growth policy so
+ * that repeated appends stay amortized O(1). Returns false if the
+ * vector could not grow.
+ */
+cstd_inline bool 
+cstd_vector_reserve_more(vector_t* vec, const size_t count) {
+    if (count <= vec->capacity - vec->size) {
+        return true;
+    }
+    if (count > SIZE_MAX - vec->size) {
+        return false;
+    }
+    return cstd_vector_grow(vec, vec->size + count);
+}
+
+/*
+ * Appends count elements stored contiguously at elements with a single
+ * capacity check and one copy. Returns false, leaving the vector
+ * unchanged, if it could not grow.
+ */
+cstd_inline bool 
+cstd_vector_append_n(vector_t* vec, const void* elements, const size_t count) {
+    if (!cstd_vector_reserve_more(vec, count)) {
+        return false;
+    }
+    if (count > 0) {
+        memcpy((char*)vec->data + vec->size * vec->element_size, elements,
+               count * vec->element_size);
+    }
+    vec->size += count;
+    return true;
+}
+
+/*
+ * Appends count copies of element. Returns false, leaving the vector
+ * unchanged, if it could not grow.
+ */
+cstd_inline bool 
+cstd_vector_push_back_n(vector_t* vec, const void* element,
+                        const size_t count) {
+    if (!cstd_vector_reserve_more(vec, count)) {
+        return false;
+    }
+    char* slot = (char*)vec->data + vec->size * vec->element_size;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(slot, element, vec->element_size);
+        slot += vec->element_size;
+    }
+    vec->size += count;
+    return true;
 }
 
 /* 
@@ -156,13 +325,14 @@ cstd_vector_empty(vector_t* vec) {
  * Inserts the given element into the vector at the given index. If the
  * vector is already full, it is resized before the element is inserted.
  * The element size is given in the vector struct, so there is no need
- * to pass the size as a parameter.
+ * to pass the size as a parameter. Returns false, leaving the vector
+ * unchanged, if it could not grow.
  */
-cstd_inline void 
+cstd_inline bool 
 cstd_vector_insert(vector_t* vec, const size_t index, void* element) {
     assert(index <= vec->size);
-    if (vec->size == vec->capacity) {
-        cstd_vector_resize(vec);
+    if (vec->size == vec->capacity && !cstd_vector_resize(vec)) {
+        return false;
     }
     memmove((char*)vec->data + (index + 1) * vec->element_size,
             (char*)vec->data + index * vec->element_size,
@@ -173,6 +343,7 @@ cstd_vector_insert(vector_t* vec, const size_t index, void* element) {
                   element, 
                   vec->element_size);
     vec->size++;
+    return true;
 }
 
 /* 
@@ -204,3 +375,181 @@ cstd_inline size_t
 cstd_vector_capacity(vector_t* vec) {
     return vec->capacity;
 }
+
+/*
+ * Returns the capacity a typed vector grows to so that at least
+ * min_capacity elements of element_size bytes fit: 1.5 times the
+ * current capacity, at least VECTOR_INIT_CAPACITY. Returns 0 if
+ * min_capacity elements would overflow a size_t.
+ */
+cstd_inline size_t 
+cstd_vector_grown_capacity(const size_t capacity, const size_t min_capacity,
+                           const size_t element_size) {
+    size_t max_capacity = SIZE_MAX / element_size;
+    if (min_capacity > max_capacity) {
+        return 0;
+    }
+    size_t grown = capacity > max_capacity - capacity / 2
+        ? max_capacity : capacity + capacity / 2;
+    if (grown < VECTOR_INIT_CAPACITY) {
+        grown = VECTOR_INIT_CAPACITY < max_capacity ? VECTOR_INIT_CAPACITY
+                                                    : max_capacity;
+    }
+    return grown < min_capacity ? min_capacity : grown;
+}
+
+/*
+ * Defines name_t, a vector of T, with typed functions name_init,
+ * name_init_with_allocator, name_free, name_reserve, name_shrink_to_fit,
+ * name_push_back, name_append_n, name_pop_back, name_at, name_insert,
+ * name_erase, name_clear, name_empty, name_size and name_capacity that
+ * behave like their vector_t counterparts. The element size is
+ * sizeof(T), so the compiler sees fixed-size copies it can turn into
+ * plain loads and stores. vector_t remains the choice when the element
+ * size is only known at run time. Use it once per type at file scope:
+ *
+ *     CSTD_VECTOR_DEFINE(int_vector, int)
+ */
+#define CSTD_VECTOR_DEFINE(name, T)                                          \
+    typedef struct {                                                         \
+        T*     data;                                                         \
+        size_t size;                                                         \
+        size_t capacity;                                                     \
+        const cstd_allocator_t* allocator;                                   \
+    } name##_t;                                                              \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_init_with_allocator(name##_t* vec,                                \
+                               const cstd_allocator_t* allocator) {          \
+        vec->allocator = cstd_allocator_or_default(allocator);               \
+        vec->data = (T*)cstd_alloc(vec->allocator,                           \
+                                   VECTOR_INIT_CAPACITY * sizeof(T));        \
+        vec->size = 0;                                                       \
+        vec->capacity = vec->data ? VECTOR_INIT_CAPACITY : 0;                \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_init(name##_t* vec) {                                             \
+        name##_init_with_allocator(vec, NULL);                               \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_free(name##_t* vec) {                                             \
+        cstd_free(vec->allocator, vec->data, vec->capacity * sizeof(T));     \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_set_capacity(name##_t* vec, const size_t new_capacity) {          \
+        if (new_capacity > SIZE_MAX / sizeof(T)) {                           \
+            return false;                                                    \
+        }                                                                    \
+        T* new_data = (T*)cstd_realloc(vec->allocator, vec->data,            \
+                                       vec->capacity * sizeof(T),            \
+                                       new_capacity * sizeof(T));            \
+        if (!new_data && new_capacity > 0) {                                 \
+            return false;                                                    \
+        }                                                                    \
+        vec->data = new_data;                                                \
+        vec->capacity = new_capacity;                                        \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_reserve(name##_t* vec, const size_t new_capacity) {               \
+        if (new_capacity > vec->capacity) {                                  \
+            return name##_set_capacity(vec, new_capacity);                   \
+        }                                                                    \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_shrink_to_fit(name##_t* vec) {                                    \
+        if (vec->size < vec->capacity) {                                     \
+            name##_set_capacity(vec, vec->size);                             \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_reserve_more(name##_t* vec, const size_t count) {                 \
+        if (count <= vec->capacity - vec->size) {                            \
+            return true;                                                     \
+        }                                                                    \
+        size_t new_capacity = count > SIZE_MAX - vec->size ? 0 :             \
+            cstd_vector_grown_capacity(vec->capacity, vec->size + count,     \
+                                       sizeof(T));                           \
+        return new_capacity > 0 && name##_set_capacity(vec, new_capacity);   \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_push_back(name##_t* vec, const T element) {                       \
+        if (vec->size == vec->capacity && !name##_reserve_more(vec, 1)) {    \
+            return false;                                                    \
+        }                                                                    \
+        vec->data[vec->size++] = element;                                    \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_append_n(name##_t* vec, const T* elements, const size_t count) {  \
+        if (!name##_reserve_more(vec, count)) {                              \
+            return false;                                                    \
+        }                                                                    \
+        if (count > 0) {                                                     \
+            memcpy(vec->data + vec->size, elements, count * sizeof(T));      \
+        }                                                                    \
+        vec->size += count;                                                  \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_pop_back(name##_t* vec) {                                         \
+        if (vec->size > 0) {                                                 \
+            vec->size--;                                                     \
+        }                                                                    \
+    }                                                                        \
+                                                                             \
+    cstd_inline T*                                                           \
+    name##_at(name##_t* vec, const size_t index) {                           \
+        return index < vec->size ? &vec->data[index] : NULL;                 \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_insert(name##_t* vec, const size_t index, const T element) {      \
+        assert(index <= vec->size);                                          \
+        if (vec->size == vec->capacity && !name##_reserve_more(vec, 1)) {    \
+            return false;                                                    \
+        }                                                                    \
+        memmove(vec->data + index + 1, vec->data + index,                    \
+                (vec->size - index) * sizeof(T));                            \
+        vec->data[index] = element;                                          \
+        vec->size++;                                                         \
+        return true;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_erase(name##_t* vec, const size_t index) {                        \
+        assert(index < vec->size);                                           \
+        memmove(vec->data + index, vec->data + index + 1,                    \
+                (vec->size - index - 1) * sizeof(T));                        \
+        vec->size--;                                                         \
+    }                                                                        \
+                                                                             \
+    cstd_inline void                                                         \
+    name##_clear(name##_t* vec) {                                            \
+        vec->size = 0;                                                       \
+    }                                                                        \
+                                                                             \
+    cstd_inline bool                                                         \
+    name##_empty(const name##_t* vec) {                                      \
+        return vec->size == 0;                                               \
+    }                                                                        \
+                                                                             \
+    cstd_inline size_t                                                       \
+    name##_size(const name##_t* vec) {                                       \
+        return vec->size;                                                    \
+    }                                                                        \
+                                                                             \
+    cstd_inline size_t                                                       \
+    name##_capacity(const name##_t* vec) {                                   \
+        return vec->capacity;                                                \
+    }
@@ -0,0 +1,459 @@
+#pragma once
+
+#include "cstd_vector.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/*
+ * ftruncate and fstat are only declared in strict C mode when POSIX.1-2008
+ * is requested before the first system header; the GNU dialects
+ * (-std=gnu11) request it already.
+ */
+#if !defined(_WIN32) && defined(__STRICT_ANSI__) && \
+    !(defined(_POSIX_C_SOURCE) && _POSIX_C_SOURCE >= 200809L)
+    #error "cstd_vector_file.h needs ftruncate and fstat; \
+compile with -D_POSIX_C_SOURCE=200809L or -std=gnu11"
+#endif
+
+/*
+ * File-backed vectors. The elements of a vector_t opened with
+ * cstd_vector_open_file live in a memory-mapped file, behind a small
+ * header, so reopening the file maps the elements back in place with
+ * no parsing or copying. The mapping is managed by an allocator, so
+ * every vector_t function works unchanged; growing the vector extends
+ * the file and remaps it, which moves the elements like a realloc.
+ */
+
+/* "CSTDVEC1" in little-endian byte order */
+#define CSTD_VECTOR_FILE_MAGIC 0x3143455644545343ull
+
+/* Elements start this many bytes into the file */
+#define CSTD_VECTOR_FILE_HEADER_SIZE 64
+
+typedef struct {
+    uint64_t magic;
+    uint64_t element_size;
+    uint64_t size;
+    uint64_t capacity;
+    uint64_t checksum;  /* of the fields above */
+} cstd_vector_file_header_t;
+
+/*
+ * State of an open file, owned by the vector through its allocator.
+ */
+typedef struct {
+    cstd_allocator_t allocator;
+    uint64_t tag;                       /* CSTD_VECTOR_FILE_MAGIC */
+    cstd_vector_file_header_t* header;  /* start of the mapping */
+    size_t mapped;                      /* bytes mapped, the file size */
+#if defined(_WIN32)
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int fd;
+#endif
+} cstd_vector_file_t;
+
+/*
+ * Checksum of the header fields, used to reject files that are not
+ * vectors or whose header was torn by a crash.
+ */
+cstd_inline uint64_t
+cstd_vector_file_checksum(const cstd_vector_file_header_t* header) {
+    uint64_t fields[4] = {
+        header->magic, header->element_size, header->size, header->capacity
+    };
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < 4; i++) {
+        hash = (hash ^ fields[i]) * 0x100000001b3ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+#if defined(_WIN32)
+
+/*
+ * Maps the first bytes of the file, creating a new mapping object
+ * since a Windows mapping cannot change size.
+ */
+cstd_inline bool
+cstd_vector_file_map(cstd_vector_file_t* file, const size_t bytes) {
+    uint64_t size = bytes;
+    file->mapping = CreateFileMappingA(file->file, NULL, PAGE_READWRITE,
+                                       (DWORD)(size >> 32), (DWORD)size,
+                                       NULL);
+    if (!file->mapping) {
+        return false;
+    }
+    file->header = (cstd_vector_file_header_t*)
+        MapViewOfFile(file->mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!file->header) {
+        CloseHandle(file->mapping);
+        file->mapping = NULL;
+        return false;
+    }
+    file->mapped = bytes;
+    return true;
+}
+
+cstd_inline void
+cstd_vector_file_unmap(cstd_vector_file_t* file) {
+    UnmapViewOfFile(file->header);
+    CloseHandle(file->mapping);
+    file->header = NULL;
+    file->mapping = NULL;
+}
+
+/*
+ * Sets the file size and remaps it. On failure the old mapping is
+ * restored.
+ */
+cstd_inline bool
+cstd_vector_file_resize(cstd_vector_file_t* file, const size_t bytes) {
+    size_t old_bytes = file->mapped;
+    LARGE_INTEGER end;
+    end.QuadPart = (LONGLONG)bytes;
+    cstd_vector_file_unmap(file);
+    if (bytes < old_bytes) {
+        SetFilePointerEx(file->file, end, NULL, FILE_BEGIN);
+        SetEndOfFile(file->file);
+    }
+    if (cstd_vector_file_map(file, bytes)) {
+        return true;
+    }
+    cstd_vector_file_map(file, old_bytes);
+    return false;
+}
+
+cstd_inline bool
+cstd_vector_file_flush(cstd_vector_file_t* file) {
+    return FlushViewOfFile(file->header, file->mapped) &&
+           FlushFileBuffers(file->file);
+}
+
+cstd_inline void
+cstd_vector_file_close_handles(cstd_vector_file_t* file) {
+    if (file->header) {
+        cstd_vector_file_unmap(file);
+    }
+    CloseHandle(file->file);
+}
+
+/*
+ * Opens or creates the file and returns its size through bytes.
+ */
+cstd_inline bool
+cstd_vector_file_open_path(cstd_vector_file_t* file, const char* path,
+                           size_t* bytes) {
+    LARGE_INTEGER size;
+    file->header = NULL;
+    file->mapping = NULL;
+    file->file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                             OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file->file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    if (!GetFileSizeEx(file->file, &size) ||
+        (uint64_t)size.QuadPart > SIZE_MAX) {
+        CloseHandle(file->file);
+        return false;
+    }
+    *bytes = (size_t)size.QuadPart;
+    return true;
+}
+
+#else
+
+/*
+ * Maps the first bytes of the file.
+ */
+cstd_inline bool
+cstd_vector_file_map(cstd_vector_file_t* file, const size_t bytes) {
+    void* map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     file->fd, 0);
+    if (map == MAP_FAILED) {
+        return false;
+    }
+    file->header = (cstd_vector_file_header_t*)map;
+    file->mapped = bytes;
+    return true;
+}
+
+/*
+ * Sets the file size and remaps it, with mremap where available and
+ * otherwise by mapping the new size before unmapping the old one. The
+ * file pages stay in the page cache either way, so nothing is copied.
+ * On failure the old mapping and file size are kept.
+ */
+cstd_inline bool
+cstd_vector_file_resize(cstd_vector_file_t* file, const size_t bytes) {
+    size_t old_bytes = file->mapped;
+    if (bytes > old_bytes && ftruncate(file->fd, (off_t)bytes) != 0) {
+        return false;
+    }
+#if defined(MREMAP_MAYMOVE)
+    void* map = mremap(file->header, old_bytes, bytes, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        map = NULL;
+    }
+#else
+    void* map = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     file->fd, 0);
+    if (map == MAP_FAILED) {
+        map = NULL;
+    } else {
+        munmap(file->header, old_bytes);
+    }
+#endif
+    if (!map) {
+        if (bytes > old_bytes) {
+            ftruncate(file->fd, (off_t)old_bytes);
+        }
+        return false;
+    }
+    file->header = (cstd_vector_file_header_t*)map;
+    file->mapped = bytes;
+    if (bytes < old_bytes) {
+        ftruncate(file->fd, (off_t)bytes);
+    }
+    return true;
+}
+
+cstd_inline bool
+cstd_vector_file_flush(cstd_vector_file_t* file) {
+    return msync(file->header, file->mapped, MS_SYNC) == 0;
+}
+
+cstd_inline void
+cstd_vector_file_close_handles(cstd_vector_file_t* file) {
+    if (file->header) {
+        munmap(file->header, file->mapped);
+    }
+    close(file->fd);
+}
+
+/*
+ * Opens or creates the file and returns its size through bytes.
+ */
+cstd_inline bool
+cstd_vector_file_open_path(cstd_vector_file_t* file, const char* path,
+                           size_t* bytes) {
+    struct stat st;
+    file->header = NULL;
+    file->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (file->fd < 0) {
+        return false;
+    }
+    if (fstat(file->fd, &st) != 0 || (uint64_t)st.st_size > SIZE_MAX) {
+        close(file->fd);
+        return false;
+    }
+    *bytes = (size_t)st.st_size;
+    return true;
+}
+
+#endif
+
+/*
+ * Allocator callbacks of an open file. The buffer can only be resized
+ * or released; it is created by cstd_vector_open_file.
+ */
+cstd_inline void*
+cstd_vector_file_allocate(void* context, size_t size) {
+    cstd_unused(context);
+    cstd_unused(size);
+    return NULL;
+}
+
+cstd_inline void*
+cstd_vector_file_reallocate(void* context, void* data, size_t old_size,
+                            size_t new_size) {
+    cstd_vector_file_t* file = (cstd_vector_file_t*)context;
+    cstd_unused(data);
+    cstd_unused(old_size);
+    if (new_size > SIZE_MAX - CSTD_VECTOR_FILE_HEADER_SIZE ||
+        !cstd_vector_file_resize(file,
+                                 CSTD_VECTOR_FILE_HEADER_SIZE + new_size)) {
+        return NULL;
+    }
+    /*
+     * Keep the header valid so that the file still opens if the vector
+     * is never synced again: the size recorded at the last sync is
+     * still backed by the file, unless the vector shrank below it.
+     */
+    cstd_vector_file_header_t* header = file->header;
+    header->capacity = new_size / header->element_size;
+    if (header->size > header->capacity) {
+        header->size = header->capacity;
+    }
+    header->checksum = cstd_vector_file_checksum(header);
+    return (char*)header + CSTD_VECTOR_FILE_HEADER_SIZE;
+}
+
+cstd_inline void
+cstd_vector_file_deallocate(void* context, void* data, size_t size) {
+    cstd_vector_file_t* file = (cstd_vector_file_t*)context;
+    cstd_unused(data);
+    cstd_unused(size);
+    cstd_vector_file_close_handles(file);
+    free(file);
+}
+
+/*
+ * Returns the open file behind a vector, or NULL if the vector is not
+ * file-backed. The allocator callbacks have a different address in each
+ * translation unit, so the file is recognized by its allocator being
+ * embedded in the state its context points to, and by the tag that
+ * follows it.
+ */
+cstd_inline cstd_vector_file_t*
+cstd_vector_file(const vector_t* vec) {
+    cstd_vector_file_t* file = (cstd_vector_file_t*)vec->allocator->context;
+    if (!file || &file->allocator != vec->allocator ||
+        file->tag != CSTD_VECTOR_FILE_MAGIC) {
+        return NULL;
+    }
+    return file;
+}
+
+/*
+ * Writes the size and capacity of the vector and the checksum to the
+ * file header.
+ */
+cstd_inline void
+cstd_vector_file_write_header(vector_t* vec, cstd_vector_file_t* file) {
+    file->header->size = vec->size;
+    file->header->capacity = vec->capacity;
+    file->header->checksum = cstd_vector_file_checksum(file->header);
+}
+
+/*
+ * Checks that a mapped file holds a vector of element_size elements
+ * that fits in the file.
+ */
+cstd_inline bool
+cstd_vector_file_valid(const cstd_vector_file_t* file,
+                       const size_t element_size) {
+    const cstd_vector_file_header_t* header = file->header;
+    size_t data_bytes = file->mapped - CSTD_VECTOR_FILE_HEADER_SIZE;
+    return header->magic == CSTD_VECTOR_FILE_MAGIC &&
+           header->element_size == element_size &&
+           header->checksum == cstd_vector_file_checksum(header) &&
+           header->size <= header->capacity &&
+           header->capacity <= data_bytes / element_size;
+}
+
+/*
+ * Opens the vector stored in the file at path, creating an empty one
+ * if the file is empty or does not exist. The elements are mapped in
+ * place, so opening costs the same for any size of vector. The file
+ * stays open until the vector is freed, and changes reach the file
+ * through the page cache; call cstd_vector_sync_file to make them
+ * durable and cstd_vector_close_file to record the final size. Returns
+ * false, leaving an empty heap vector, if the file could not be opened
+ * or does not hold a vector of element_size elements.
+ */
+cstd_inline bool
+cstd_vector_open_file(vector_t* vec, const char* path,
+                      const size_t element_size) {
+    vec->data = NULL;
+    vec->size = 0;
+    vec->capacity = 0;
+    vec->element_size = element_size;
+    vec->allocator = cstd_allocator_or_default(NULL);
+    vec->growth = CSTD_VECTOR_GROWTH_1_5X;
+    if (element_size == 0) {
+        return false;
+    }
+
+    cstd_vector_file_t* file =
+        (cstd_vector_file_t*)malloc(sizeof(cstd_vector_file_t));
+    size_t bytes;
+    if (!file) {
+        return false;
+    }
+    if (!cstd_vector_file_open_path(file, path, &bytes)) {
+        free(file);
+        return false;
+    }
+
+    bool created = bytes == 0;
+    if (created) {
+        size_t capacity = VECTOR_INIT_CAPACITY;
+        if (capacity > (SIZE_MAX - CSTD_VECTOR_FILE_HEADER_SIZE) /
+                       element_size) {
+            capacity = 0;
+        }
+        bytes = CSTD_VECTOR_FILE_HEADER_SIZE + capacity * element_size;
+        file->mapped = 0;
+#if !defined(_WIN32)
+        if (ftruncate(file->fd, (off_t)bytes) != 0) {
+            cstd_vector_file_close_handles(file);
+            free(file);
+            return false;
+        }
+#endif
+    }
+    if (bytes < CSTD_VECTOR_FILE_HEADER_SIZE ||
+        !cstd_vector_file_map(file, bytes)) {
+        cstd_vector_file_close_handles(file);
+        free(file);
+        return false;
+    }
+    if (created) {
+        file->header->magic = CSTD_VECTOR_FILE_MAGIC;
+        file->header->element_size = element_size;
+        file->header->size = 0;
+        file->header->capacity =
+            (bytes - CSTD_VECTOR_FILE_HEADER_SIZE) / element_size;
+        file->header->checksum = cstd_vector_file_checksum(file->header);
+    } else if (!cstd_vector_file_valid(file, element_size)) {
+        cstd_vector_file_close_handles(file);
+        free(file);
+        return false;
+    }
+
+    file->allocator.allocate = cstd_vector_file_allocate;
+    file->allocator.reallocate = cstd_vector_file_reallocate;
+    file->allocator.deallocate = cstd_vector_file_deallocate;
+    file->allocator.context = file;
+    file->tag = CSTD_VECTOR_FILE_MAGIC;
+    vec->allocator = &file->allocator;
+    vec->data = (char*)file->header + CSTD_VECTOR_FILE_HEADER_SIZE;
+    vec->size = (size_t)file->header->size;
+    vec->capacity = (size_t)file->header->capacity;
+    return true;
+}
+
+/*
+ * Records the size of a file-backed vector in its header and flushes
+ * the header and elements to disk. Returns false if the flush failed.
+ */
+cstd_inline bool
+cstd_vector_sync_file(vector_t* vec) {
+    cstd_vector_file_t* file = cstd_vector_file(vec);
+    assert(file);
+    cstd_vector_file_write_header(vec, file);
+    return cstd_vector_file_flush(file);
+}
+
+/*
+ * Records the size of a file-backed vector in its header, then unmaps
+ * and closes the file. Pending changes are written back by the system;
+ * call cstd_vector_sync_file first to wait for them.
+ */
+cstd_inline void
+cstd_vector_close_file(vector_t* vec) {
+    cstd_vector_file_t* file = cstd_vector_file(vec);
+    assert(file);
+    cstd_vector_file_write_header(vec, file);
+    cstd_vector_free(vec);
+}
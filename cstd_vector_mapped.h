@@ -0,0 +1,220 @@
+#pragma once
+
+#include "cstd_vector.h"
+
+#if defined(_WIN32)
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <unistd.h>
+#endif
+
+/*
+ * Anonymous reservations need MAP_ANONYMOUS and MAP_NORESERVE, which
+ * are only declared with the default feature set. In strict C mode,
+ * compile with -D_DEFAULT_SOURCE; the GNU dialects (-std=gnu11) enable
+ * it already.
+ */
+#if !defined(_WIN32) && \
+    (!(defined(MAP_ANONYMOUS) || defined(MAP_ANON)) || \
+     !defined(MAP_NORESERVE))
+    #error "cstd_vector_mapped.h needs MAP_ANONYMOUS and MAP_NORESERVE; \
+compile with -D_DEFAULT_SOURCE or -std=gnu11"
+#endif
+
+/*
+ * Mapped vectors for very large buffers. A vector_t initialized with
+ * cstd_vector_init_mapped takes its buffer from a reservation of
+ * address space made up front, through an allocator that commits
+ * memory in place as the vector grows. Growing never copies, and
+ * pointers to elements stay valid until the vector is freed; every
+ * vector_t function works unchanged.
+ */
+
+/*
+ * Mapped vectors commit memory in steps of this many bytes, which is
+ * also the alignment of the reservation so that transparent huge pages
+ * can back it.
+ */
+#define CSTD_VECTOR_MAPPED_COMMIT_SIZE ((size_t)2 << 20)
+
+/*
+ * A reservation, owned by the vector through its allocator.
+ */
+typedef struct {
+    cstd_allocator_t allocator;
+    void*            base;
+    size_t           reserved;  /* bytes of address space */
+} cstd_vector_mapping_t;
+
+/*
+ * Reserves bytes of address space without backing it with memory.
+ * bytes is a multiple of CSTD_VECTOR_MAPPED_COMMIT_SIZE, and on POSIX
+ * systems the result is aligned to it. Returns NULL on failure.
+ */
+cstd_inline void* 
+cstd_vector_map_reserve(const size_t bytes, const bool huge_pages) {
+#if defined(_WIN32)
+    cstd_unused(huge_pages);
+    return VirtualAlloc(NULL, bytes, MEM_RESERVE, PAGE_NOACCESS);
+#else
+    #if defined(MAP_ANONYMOUS)
+        int flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    #else
+        int flags = MAP_PRIVATE | MAP_ANON | MAP_NORESERVE;
+    #endif
+    /* Over-reserve by one step and trim both ends to align the base */
+    size_t align = CSTD_VECTOR_MAPPED_COMMIT_SIZE;
+    if (bytes > SIZE_MAX - align) {
+        return NULL;
+    }
+    void* map = mmap(NULL, bytes + align, PROT_NONE, flags, -1, 0);
+    if (map == MAP_FAILED) {
+        return NULL;
+    }
+    char* base = (char*)cstd_align_up((size_t)map, align);
+    size_t head = (size_t)(base - (char*)map);
+    if (head > 0) {
+        munmap(map, head);
+    }
+    munmap(base + bytes, align - head);
+    #if defined(MADV_HUGEPAGE)
+        if (huge_pages) {
+            madvise(base, bytes, MADV_HUGEPAGE);
+        }
+    #else
+        cstd_unused(huge_pages);
+    #endif
+    return base;
+#endif
+}
+
+/*
+ * Backs bytes of reserved address space at data with readable and
+ * writable memory.
+ */
+cstd_inline bool 
+cstd_vector_map_commit(void* data, const size_t bytes) {
+#if defined(_WIN32)
+    return VirtualAlloc(data, bytes, MEM_COMMIT, PAGE_READWRITE) != NULL;
+#else
+    return mprotect(data, bytes, PROT_READ | PROT_WRITE) == 0;
+#endif
+}
+
+/*
+ * Returns committed memory to the system, keeping the address space
+ * reserved.
+ */
+cstd_inline void 
+cstd_vector_map_decommit(void* data, const size_t bytes) {
+#if defined(_WIN32)
+    VirtualFree(data, bytes, MEM_DECOMMIT);
+#else
+    madvise(data, bytes, MADV_DONTNEED);
+    mprotect(data, bytes, PROT_NONE);
+#endif
+}
+
+/*
+ * Releases a reservation made by cstd_vector_map_reserve.
+ */
+cstd_inline void 
+cstd_vector_map_release(void* data, const size_t bytes) {
+#if defined(_WIN32)
+    cstd_unused(bytes);
+    VirtualFree(data, 0, MEM_RELEASE);
+#else
+    munmap(data, bytes);
+#endif
+}
+
+/*
+ * Allocator callbacks of a reservation. The buffer always starts at
+ * the base of the reservation: resizing commits or decommits the
+ * difference in place and fails past the end of the reservation.
+ */
+cstd_inline void* 
+cstd_vector_mapping_allocate(void* context, size_t size) {
+    cstd_unused(context);
+    cstd_unused(size);
+    return NULL;
+}
+
+cstd_inline void* 
+cstd_vector_mapping_reallocate(void* context, void* data, size_t old_size,
+                               size_t new_size) {
+    cstd_vector_mapping_t* mapping = (cstd_vector_mapping_t*)context;
+    cstd_unused(data);
+    if (new_size > mapping->reserved) {
+        return NULL;
+    }
+    size_t committed = cstd_align_up(old_size,
+                                     CSTD_VECTOR_MAPPED_COMMIT_SIZE);
+    size_t needed = cstd_align_up(new_size, CSTD_VECTOR_MAPPED_COMMIT_SIZE);
+    if (needed > committed) {
+        if (!cstd_vector_map_commit((char*)mapping->base + committed,
+                                    needed - committed)) {
+            return NULL;
+        }
+    } else if (needed < committed) {
+        cstd_vector_map_decommit((char*)mapping->base + needed,
+                                 committed - needed);
+    }
+    return mapping->base;
+}
+
+cstd_inline void 
+cstd_vector_mapping_deallocate(void* context, void* data, size_t size) {
+    cstd_vector_mapping_t* mapping = (cstd_vector_mapping_t*)context;
+    cstd_unused(data);
+    cstd_unused(size);
+    cstd_vector_map_release(mapping->base, mapping->reserved);
+    free(mapping);
+}
+
+/*
+ * Initialize a mapped vector for very large buffers. Address space for
+ * max_capacity elements is reserved up front and memory is committed as
+ * the vector grows, so growing never copies and pointers to elements
+ * stay valid until the vector is freed. The vector cannot grow past
+ * max_capacity, rounded up to whole commit steps. With huge_pages the
+ * buffer is marked for transparent huge pages where the system supports
+ * them. Returns false if the address space could not be reserved,
+ * leaving an empty heap vector.
+ */
+cstd_inline bool 
+cstd_vector_init_mapped(vector_t* vec, const size_t element_size,
+                        const size_t max_capacity, const bool huge_pages) {
+    vec->data = NULL;
+    vec->size = 0;
+    vec->capacity = 0;
+    vec->element_size = element_size;
+    vec->allocator = cstd_allocator_or_default(NULL);
+    vec->growth = CSTD_VECTOR_GROWTH_1_5X;
+    if (element_size == 0 || max_capacity == 0 ||
+        max_capacity > (SIZE_MAX - CSTD_VECTOR_MAPPED_COMMIT_SIZE) /
+                       element_size) {
+        return false;
+    }
+
+    cstd_vector_mapping_t* mapping =
+        (cstd_vector_mapping_t*)malloc(sizeof(cstd_vector_mapping_t));
+    if (!mapping) {
+        return false;
+    }
+    mapping->reserved = cstd_align_up(max_capacity * element_size,
+                                      CSTD_VECTOR_MAPPED_COMMIT_SIZE);
+    mapping->base = cstd_vector_map_reserve(mapping->reserved, huge_pages);
+    if (!mapping->base) {
+        free(mapping);
+        return false;
+    }
+    mapping->allocator.allocate = cstd_vector_mapping_allocate;
+    mapping->allocator.reallocate = cstd_vector_mapping_reallocate;
+    mapping->allocator.deallocate = cstd_vector_mapping_deallocate;
+    mapping->allocator.context = mapping;
+    vec->allocator = &mapping->allocator;
+    vec->data = mapping->base;
+    return true;
+}
@@ -5,7 +5,8 @@ int32_t string_compare(const void* a, const void* b) {
 }
 
 void print_map(map_t* map) {
-    for (node_t* node = map->root; node != NULL; node = node->right) {
+    for (node_t* node = cstd_map_first(map); node != NULL;
+         node = cstd_map_next(node)) {
         printf("%s: %d\n", (char*)node->key, *(int*)node->value);
     }
 }
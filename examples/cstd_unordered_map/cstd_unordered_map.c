@@ -48,7 +48,8 @@ int main() {
     for (size_t i = 0; i < age_map.capacity; ++i) {
         key_value_pair_t *pair = age_map.buckets[i];
         while (pair) {
-            printf("%s: %d\n", (const char *)pair->key, *(int *)pair->value);
+            printf("%s: %d\n", (const char *)cstd_unordered_map_pair_key(pair),
+                   *(int *)cstd_unordered_map_pair_value(&age_map, pair));
             pair = pair->next;
         }
     }
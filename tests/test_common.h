@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../cstd_common.h"
+
+/*
+ * Helpers shared by the tests. Each test is a C file that builds and
+ * runs on its own, along with its _other.c companion if it has one, and
+ * exits non-zero on failure, for example:
+ *
+ *     cc -std=gnu11 -o test tests/test_vector_file.c \
+ *         tests/test_vector_file_other.c && ./test
+ */
+
+static int test_failures;
+
+/*
+ * Records a failure, with its location, when cond is false.
+ */
+#define TEST_CHECK(cond)                                                     \
+    do {                                                                     \
+        if (!(cond)) {                                                       \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,           \
+                    __LINE__, #cond);                                        \
+            test_failures++;                                                 \
+        }                                                                    \
+    } while (0)
+
+/*
+ * Prints the outcome and returns the exit status for main.
+ */
+cstd_inline int
+test_report(const char* name) {
+    if (test_failures > 0) {
+        printf("%s: %d failed\n", name, test_failures);
+        return 1;
+    }
+    printf("%s: ok\n", name);
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "../cstd_list.h"
+#include "../cstd_map.h"
+#include "../cstd_unordered_map.h"
+#include "../cstd_concurrent_unordered_map.h"
+#include "../cstd_concurrent_unordered_set.h"
+#include "test_common.h"
+
+/*
+ * The concurrent containers must compile when other cstd headers, and
+ * with them the C library headers, are included first. Build in strict
+ * C mode with the documented feature macro:
+ *
+ *     cc -std=c11 -D_POSIX_C_SOURCE=200809L tests/test_include_order.c
+ */
+
+static uint32_t
+key_hash(const void* key) {
+    return *(const uint32_t*)key;
+}
+
+static bool
+key_equals(const void* a, const void* b) {
+    return *(const uint32_t*)a == *(const uint32_t*)b;
+}
+
+int main(void) {
+    concurrent_unordered_map_t map;
+    uint32_t key = 7;
+    uint32_t value = 42;
+    bool initialized = cstd_concurrent_unordered_map_init(
+        &map, sizeof(uint32_t), sizeof(uint32_t), key_hash, key_equals);
+    TEST_CHECK(initialized);
+    if (!initialized) {
+        return test_report("include_order");
+    }
+    cstd_concurrent_unordered_map_insert(&map, &key, &value);
+    uint32_t found = 0;
+    TEST_CHECK(cstd_concurrent_unordered_map_find(&map, &key, &found));
+    TEST_CHECK(found == value);
+    cstd_concurrent_unordered_map_free(&map);
+    return test_report("include_order");
+}
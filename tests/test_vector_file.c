@@ -0,0 +1,125 @@
+#include "../cstd_vector_file.h"
+#include "test_common.h"
+
+#include <sys/wait.h>
+
+/*
+ * File-backed vectors must reopen with the last synced records after
+ * the vector grew or shrank without another sync, whether it was then
+ * freed without cstd_vector_close_file or the process died. A vector
+ * opened in one translation unit must also sync and close in another.
+ *
+ * Build together with test_vector_file_other.c.
+ */
+
+#define TEST_PATH "test_vector_file.vec"
+#define SYNCED 1000
+
+/* Defined in test_vector_file_other.c */
+bool other_open_file(vector_t* vec, const char* path, size_t element_size);
+bool other_sync_file(vector_t* vec);
+void other_close_file(vector_t* vec);
+
+/*
+ * Creates the file with SYNCED records and syncs it, leaving the vector
+ * open at capacity.
+ */
+static bool
+open_synced(vector_t* vec) {
+    remove(TEST_PATH);
+    if (!cstd_vector_open_file(vec, TEST_PATH, sizeof(uint64_t))) {
+        return false;
+    }
+    for (uint64_t i = 0; i < SYNCED; i++) {
+        cstd_vector_push_back(vec, &i);
+    }
+    cstd_vector_shrink_to_fit(vec);
+    return cstd_vector_sync_file(vec);
+}
+
+/*
+ * Reopens the file and checks that it holds the first size records.
+ */
+static void
+check_reopen(size_t size) {
+    vector_t vec;
+    bool opened = cstd_vector_open_file(&vec, TEST_PATH, sizeof(uint64_t));
+    TEST_CHECK(opened);
+    if (!opened) {
+        return;
+    }
+    TEST_CHECK(vec.size == size);
+    for (size_t i = 0; i < vec.size && i < size; i++) {
+        TEST_CHECK(*(uint64_t*)cstd_vector_at(&vec, i) == i);
+    }
+    cstd_vector_close_file(&vec);
+}
+
+static void
+test_grow_then_free(void) {
+    vector_t vec;
+    TEST_CHECK(open_synced(&vec));
+    uint64_t value = SYNCED;
+    TEST_CHECK(cstd_vector_push_back(&vec, &value));
+    cstd_vector_free(&vec);
+    check_reopen(SYNCED);
+}
+
+static void
+test_shrink_then_free(void) {
+    vector_t vec;
+    TEST_CHECK(open_synced(&vec));
+    vec.size = 10;
+    cstd_vector_shrink_to_fit(&vec);
+    cstd_vector_free(&vec);
+    check_reopen(10);
+}
+
+static void
+test_grow_then_crash(void) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        vector_t vec;
+        if (!open_synced(&vec)) {
+            _exit(1);
+        }
+        uint64_t value = SYNCED;
+        cstd_vector_reserve(&vec, 4 * SYNCED);
+        cstd_vector_push_back(&vec, &value);
+        _exit(0);
+    }
+    int status = 0;
+    TEST_CHECK(pid > 0 && waitpid(pid, &status, 0) == pid);
+    TEST_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    check_reopen(SYNCED);
+}
+
+static void
+test_other_translation_unit(void) {
+    vector_t vec;
+    TEST_CHECK(open_synced(&vec));
+    uint64_t value = SYNCED;
+    TEST_CHECK(cstd_vector_push_back(&vec, &value));
+    TEST_CHECK(other_sync_file(&vec));
+    other_close_file(&vec);
+    check_reopen(SYNCED + 1);
+
+    bool opened = other_open_file(&vec, TEST_PATH, sizeof(uint64_t));
+    TEST_CHECK(opened);
+    if (!opened) {
+        return;
+    }
+    vec.size = SYNCED;
+    TEST_CHECK(cstd_vector_sync_file(&vec));
+    cstd_vector_close_file(&vec);
+    check_reopen(SYNCED);
+}
+
+int main(void) {
+    test_grow_then_free();
+    test_shrink_then_free();
+    test_grow_then_crash();
+    test_other_translation_unit();
+    remove(TEST_PATH);
+    return test_report("vector_file");
+}
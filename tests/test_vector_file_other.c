@@ -0,0 +1,23 @@
+#include "../cstd_vector_file.h"
+
+/*
+ * Second translation unit of test_vector_file.c, which is built
+ * together with it. A vector opened in one translation unit must be
+ * recognized as file-backed in the other, where the header's functions
+ * have their own addresses.
+ */
+
+bool
+other_open_file(vector_t* vec, const char* path, size_t element_size) {
+    return cstd_vector_open_file(vec, path, element_size);
+}
+
+bool
+other_sync_file(vector_t* vec) {
+    return cstd_vector_sync_file(vec);
+}
+
+void
+other_close_file(vector_t* vec) {
+    cstd_vector_close_file(vec);
+}